@@ -1,48 +1,39 @@
 // main.cpp (Base-case: sort integers from ints.json)
 #include <iostream>
-#include <fstream>
 #include <vector>
 #include <algorithm>
-#include "nlohmann/json.hpp"
-#include "oblivious_sort.h"
+#include <string>
+#include "bulk_loader.h"
 
-using json = nlohmann::json;
+int main(int argc, char** argv) {
+    // Usage: base_case_sort [input = ints.json] [output = sorted_output_std.json]
+    std::string input = argc > 1 ? argv[1] : "ints.json";
+    std::string output = argc > 2 ? argv[2] : "sorted_output_std.json";
 
-int main() {
-    // 1. Open ints.json (which should contain a JSON array of integers)
-    std::ifstream ifs("ints.json");
-    if (!ifs.is_open()) {
-        std::cerr << "Error: Could not open ints.json\n";
-        return 1;
-    }
-
-    // 2. Parse JSON into a vector of integers.
-    json j;
+    // 1-2. Load the integers (JSON array, one per line, or binary).
+    std::vector<int> inputValues;
     try {
-        ifs >> j;
+        inputValues = loadIntArray(input);
     }
     catch (const std::exception& e) {
-        std::cerr << "JSON parse error: " << e.what() << std::endl;
+        std::cerr << "Error: " << e.what() << std::endl;
         return 1;
     }
-    std::vector<int> inputValues = j.get<std::vector<int>>();
-    std::cout << "Loaded " << inputValues.size() << " integers from ints.json.\n";
+    std::cout << "Loaded " << inputValues.size() << " integers from " << input << ".\n";
 
     // 3. Baseline non-oblivious sort using std::sort.
     std::vector<int> sortedStd = inputValues;
 
     std::sort(sortedStd.begin(), sortedStd.end());
 
-    std::ofstream ofs_std("sorted_output_std.json");
-    if (!ofs_std.is_open()) {
-        std::cerr << "Error: Could not open sorted_output_std.json for writing\n";
-        return 1;
+    try {
+        writeIntArray(output, sortedStd, formatForPath(output));
     }
-    for (auto val : sortedStd) {
-        ofs_std << val << "\n";
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
     }
-    ofs_std.close();
-    std::cout << "Wrote sorted_output_std.json\n";
+    std::cout << "Wrote " << output << "\n";
 
     return 0;
 }
@@ -0,0 +1,120 @@
+// batch_sort_bench.cpp (Benchmark: many small oblivious sorts, one call per array vs. the batch API)
+// Usage: batch_sort_bench [arrays = 1000] [min_n = 1024] [max_n = 65536] [bucket_size = 256]
+//                         [num_threads = hardware threads] [input = int | string]
+// Array sizes are drawn log-uniformly from [min_n, max_n]. Three ways of sorting them:
+//   per_call  - a fresh storage backend and Enclave for every array, as a service
+//               calling oblivious_sort per request does;
+//   reused    - one storage backend and Enclave, oblivious_sort once per array;
+//   batch     - one oblivious_sort_batch call for all arrays.
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <cmath>
+#include <algorithm>
+#include "oblivious_sort.h"
+
+template <class Value>
+static std::vector<std::vector<Value>> makeArrays(size_t arrays, size_t min_n, size_t max_n, uint32_t seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> log_size(std::log(double(min_n)), std::log(double(max_n)));
+    std::vector<std::vector<Value>> inputs(arrays);
+    for (auto& input : inputs) {
+        input.resize(static_cast<size_t>(std::exp(log_size(gen))));
+        for (auto& v : input) {
+            if constexpr (std::is_same_v<Value, std::string>)
+                v = std::to_string(gen());
+            else
+                v = static_cast<Value>(gen());
+        }
+    }
+    return inputs;
+}
+
+// Every output must be its input in sorted order: sorted, and a permutation of the input.
+template <class Value>
+static bool allSorted(const std::vector<std::vector<Value>>& inputs, const std::vector<std::vector<Value>>& outputs) {
+    if (inputs.size() != outputs.size())
+        return false;
+    for (size_t a = 0; a < inputs.size(); a++) {
+        std::vector<Value> expected = inputs[a];
+        std::sort(expected.begin(), expected.end());
+        if (outputs[a] != expected)
+            return false;
+    }
+    return true;
+}
+
+template <class Fn>
+static double timeSeconds(Fn&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(stop - start).count();
+}
+
+template <class Value>
+static void run(size_t arrays, size_t min_n, size_t max_n, int Z, int threads) {
+    std::vector<std::vector<Value>> inputs = makeArrays<Value>(arrays, min_n, max_n, 11);
+    size_t elements = 0;
+    for (const auto& input : inputs)
+        elements += input.size();
+    EnclaveConfig config;
+    config.num_threads = threads;
+
+    auto report = [&](const char* mode, double seconds, bool ok) {
+        std::cout << mode << "," << arrays << "," << elements << "," << std::fixed << std::setprecision(3)
+                  << seconds << "," << arrays / seconds << "," << elements / seconds / 1e6 << ","
+                  << (ok ? "yes" : "no") << std::endl;
+    };
+
+    std::vector<std::vector<Value>> outputs(arrays);
+    double seconds = timeSeconds([&] {
+        for (size_t a = 0; a < arrays; a++) {
+            FlatUntrustedMemory untrusted;
+            Enclave enclave(&untrusted, config);
+            outputs[a] = enclave.oblivious_sort(inputs[a], Z);
+        }
+    });
+    report("per_call", seconds, allSorted(inputs, outputs));
+
+    outputs.assign(arrays, std::vector<Value>());
+    FlatUntrustedMemory untrusted;
+    Enclave enclave(&untrusted, config);
+    seconds = timeSeconds([&] {
+        for (size_t a = 0; a < arrays; a++)
+            outputs[a] = enclave.oblivious_sort(inputs[a], Z);
+    });
+    report("reused", seconds, allSorted(inputs, outputs));
+
+    outputs.clear();
+    seconds = timeSeconds([&] { outputs = enclave.oblivious_sort_batch(inputs, Z); });
+    report("batch", seconds, allSorted(inputs, outputs));
+}
+
+int main(int argc, char** argv) {
+    size_t arrays = argc > 1 ? std::stoul(argv[1]) : 1000;
+    size_t min_n = argc > 2 ? std::stoul(argv[2]) : 1024;
+    size_t max_n = argc > 3 ? std::stoul(argv[3]) : 65536;
+    int Z = argc > 4 ? std::stoi(argv[4]) : 256;
+    int threads = argc > 5 ? std::stoi(argv[5]) : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    std::string input = argc > 6 ? argv[6] : "int";
+
+    try {
+        std::cout << "# arrays = " << arrays << ", sizes " << min_n << ".." << max_n << ", Z = " << Z
+                  << ", threads = " << threads << ", input = " << input << "\n";
+        std::cout << "mode,arrays,elements,seconds,arrays_per_s,melem_per_s,sorted\n";
+        if (input == "string")
+            run<std::string>(arrays, min_n, max_n, Z, threads);
+        else
+            run<int32_t>(arrays, min_n, max_n, Z, threads);
+    }
+    catch (const std::exception& ex) {
+        std::cerr << "Error: " << ex.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,327 @@
+#ifndef BITONIC_NETWORK_H
+#define BITONIC_NETWORK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <array>
+#include <utility>
+#include <algorithm>
+#include <iterator>
+#include <type_traits>
+
+// Iterative, cache-blocked bitonic sorting network.
+//
+// The network is described purely by (n, tile): the sequence of compare-exchange
+// pairs it emits never depends on the data, so it keeps the data-independent access
+// pattern of the recursive formulation. Element handling is delegated to a kernel,
+// which must provide:
+//
+//   void forward(size_t i, size_t j, size_t len);
+//       compare-exchange (i + t, j + t) for t in [0, len)
+//   void mirrored(size_t i, size_t j, size_t len);
+//       compare-exchange (i + t, j - t) for t in [0, len)
+//
+// In every pair the first index is the lower one and must receive the element that
+// comes first in the kernel's order. Pairs are emitted as contiguous runs so that
+// kernels can vectorize them.
+//
+// Arbitrary lengths are handled without padding: the network is the "flip" variant
+// of bitonic sort (every block is sorted in the same direction), so a missing element
+// past n behaves like +infinity and every pair touching it is simply skipped.
+namespace bitonic {
+
+// Default working-set budget for one tile (a typical per-core L2 slice).
+constexpr size_t kDefaultTileBytes = 256 * 1024;
+
+// Helper: Compute next power of two.
+inline size_t nextPowerOfTwo(size_t n) {
+    size_t power = 1;
+    while (power < n)
+        power *= 2;
+    return power;
+}
+
+// Helper: Largest power of two that is <= n (n > 0).
+inline size_t prevPowerOfTwo(size_t n) {
+    size_t power = 1;
+    while (power * 2 <= n)
+        power *= 2;
+    return power;
+}
+
+// Number of elements of type T that fit in one tile, rounded down to a power of two.
+template <class T>
+size_t defaultTile() {
+    return std::max<size_t>(2, prevPowerOfTwo(std::max<size_t>(1, kDefaultTileBytes / sizeof(T))));
+}
+
+namespace detail {
+
+// Flip stage of a merge of size `block`: pairs (b + t, b + block - 1 - t) in every
+// block starting in [lo, hi).
+template <class Kernel>
+void flipStage(Kernel& kernel, size_t lo, size_t hi, size_t n, size_t block) {
+    size_t half = block / 2;
+    for (size_t b = lo; b < hi && b < n; b += block) {
+        size_t t0 = (b + block > n) ? b + block - n : 0;
+        if (t0 < half)
+            kernel.mirrored(b + t0, b + block - 1 - t0, half - t0);
+    }
+}
+
+// Half-cleaner stage with distance `dist`: pairs (b + t, b + dist + t) in every block
+// of size 2 * dist starting in [lo, hi).
+template <class Kernel>
+void halfStage(Kernel& kernel, size_t lo, size_t hi, size_t n, size_t dist) {
+    for (size_t b = lo; b < hi && b + dist < n; b += 2 * dist)
+        kernel.forward(b, b + dist, std::min(dist, n - b - dist));
+}
+
+// Runs the half-cleaners dist, dist/2, ..., 1 tile by tile. Every pair with a
+// distance below `tile` stays inside one aligned tile, so all of these stages are
+// completed while the tile is resident in cache.
+template <class Kernel>
+void tiledTail(Kernel& kernel, size_t n, size_t tile, size_t dist) {
+    for (size_t base = 0; base < n; base += tile)
+        for (size_t d = dist; d > 0; d /= 2)
+            halfStage(kernel, base, base + tile, n, d);
+}
+
+inline size_t clampTile(size_t tile, size_t n) {
+    return std::max<size_t>(2, std::min(prevPowerOfTwo(std::max<size_t>(tile, 1)), nextPowerOfTwo(n)));
+}
+
+// The kernel seen from position `base`, so the networks can run on one block of a range.
+template <class Kernel>
+struct OffsetKernel {
+    Kernel& kernel;
+    size_t base;
+
+    void forward(size_t i, size_t j, size_t len) { kernel.forward(base + i, base + j, len); }
+    void mirrored(size_t i, size_t j, size_t len) { kernel.mirrored(base + i, base + j, len); }
+};
+
+} // namespace detail
+
+// Sorts positions [0, n) with the kernel's order. `tile` is the number of elements
+// processed as one cache-resident block (rounded down to a power of two).
+template <class Kernel>
+void sortNetwork(size_t n, Kernel& kernel, size_t tile) {
+    if (n < 2)
+        return;
+    size_t N = nextPowerOfTwo(n);
+    tile = detail::clampTile(tile, n);
+
+    // Phase 1: fully sort every tile; all merges of size <= tile stay inside it.
+    for (size_t base = 0; base < n; base += tile) {
+        for (size_t k = 2; k <= tile; k *= 2) {
+            detail::flipStage(kernel, base, base + tile, n, k);
+            for (size_t d = k / 4; d > 0; d /= 2)
+                detail::halfStage(kernel, base, base + tile, n, d);
+        }
+    }
+
+    // Phase 2: larger merges. Only the stages whose distance reaches across tiles walk
+    // the whole array; the remaining log2(tile) stages run tile by tile.
+    for (size_t k = 2 * tile; k <= N; k *= 2) {
+        detail::flipStage(kernel, 0, N, n, k);
+        size_t d = k / 4;
+        for (; d >= tile; d /= 2)
+            detail::halfStage(kernel, 0, N, n, d);
+        detail::tiledTail(kernel, n, tile, d);
+    }
+}
+
+// Merges a bitonic sequence of power-of-two length n into the kernel's order.
+template <class Kernel>
+void mergeNetwork(size_t n, Kernel& kernel, size_t tile) {
+    if (n < 2)
+        return;
+    tile = detail::clampTile(tile, n);
+    size_t d = n / 2;
+    for (; d >= tile; d /= 2)
+        detail::halfStage(kernel, 0, n, n, d);
+    detail::tiledTail(kernel, n, tile, d);
+}
+
+// Moves the k elements that come first in the kernel's order to positions [0, k), in
+// order; the others are left in [k, n) in no particular order.
+//
+// With K = nextPowerOfTwo(k), the positions are cut into blocks of K and every block is
+// sorted. The blocks are then merged pairwise in a tree, each merge keeping only the
+// first K of its 2K elements: a flip stage between the two blocks leaves those in the
+// lower block as a bitonic sequence, which the half-cleaners sort, and the upper block
+// is dropped. That is (n / K) sorts of K plus n / K merges of K, O(n log^2 k) pairs
+// against O(n log^2 n) for sortNetwork, and the pairs still depend only on (n, k, tile).
+// A last block shorter than K is padded with missing elements, as in sortNetwork.
+template <class Kernel>
+void selectNetwork(size_t n, size_t k, Kernel& kernel, size_t tile) {
+    if (n < 2 || k == 0)
+        return;
+    size_t K = nextPowerOfTwo(k);
+    if (K >= n) {
+        sortNetwork(n, kernel, tile);
+        return;
+    }
+    for (size_t base = 0; base < n; base += K) {
+        detail::OffsetKernel<Kernel> block{ kernel, base };
+        sortNetwork(std::min(K, n - base), block, tile);
+    }
+    // After the round with distance `stride`, the block at every multiple of 2 * stride
+    // holds the first K elements of its 2 * stride positions.
+    for (size_t stride = K; stride < n; stride *= 2) {
+        for (size_t lo = 0; lo + stride < n; lo += 2 * stride) {
+            size_t hi = lo + stride;
+            size_t t0 = hi + K > n ? hi + K - n : 0;
+            kernel.mirrored(lo + t0, hi + K - 1 - t0, K - t0);
+            detail::OffsetKernel<Kernel> block{ kernel, lo };
+            mergeNetwork(K, block, tile);
+        }
+    }
+}
+
+// Kernel that compare-exchanges whole elements without branching on the comparison: both
+// elements are always taken out and written back, and the comparison only selects which
+// goes where. Trivially copyable elements are blended word by word under a mask; others
+// are moved out through pointers blended the same way.
+template <class Iter, class Before>
+struct BlendKernel {
+    using T = typename std::iterator_traits<Iter>::value_type;
+
+    Iter base;
+    Before before;
+
+    void exchange(size_t i, size_t j) {
+        bool swap = before(base[j], base[i]);
+        if constexpr (std::is_trivially_copyable_v<T>) {
+            constexpr size_t words = (sizeof(T) + 7) / 8;
+            uint64_t x[words] = {}, y[words] = {};
+            std::memcpy(x, &base[i], sizeof(T));
+            std::memcpy(y, &base[j], sizeof(T));
+            uint64_t mask = uint64_t(0) - uint64_t(swap);
+            for (size_t w = 0; w < words; w++) {
+                uint64_t d = (x[w] ^ y[w]) & mask;
+                x[w] ^= d;
+                y[w] ^= d;
+            }
+            std::memcpy(&base[i], x, sizeof(T));
+            std::memcpy(&base[j], y, sizeof(T));
+        }
+        else {
+            T x = std::move(base[i]);
+            T y = std::move(base[j]);
+            uintptr_t px = reinterpret_cast<uintptr_t>(&x);
+            uintptr_t py = reinterpret_cast<uintptr_t>(&y);
+            uintptr_t d = (px ^ py) & (uintptr_t(0) - uintptr_t(swap));
+            base[i] = std::move(*reinterpret_cast<T*>(px ^ d));
+            base[j] = std::move(*reinterpret_cast<T*>(py ^ d));
+        }
+    }
+    void forward(size_t i, size_t j, size_t len) {
+        for (size_t t = 0; t < len; t++)
+            exchange(i + t, j + t);
+    }
+    void mirrored(size_t i, size_t j, size_t len) {
+        for (size_t t = 0; t < len; t++)
+            exchange(i + t, j - t);
+    }
+};
+
+// Convenience wrapper: sorts [first, first + n) by `before`, through BlendKernel.
+template <class Iter, class Before>
+void sort(Iter first, size_t n, Before before, size_t tile) {
+    BlendKernel<Iter, Before> kernel{ first, before };
+    sortNetwork(n, kernel, tile);
+}
+
+// Convenience wrapper: moves the first k of [first, first + n) by `before` to the front,
+// through BlendKernel.
+template <class Iter, class Before>
+void select(Iter first, size_t n, size_t k, Before before, size_t tile) {
+    BlendKernel<Iter, Before> kernel{ first, before };
+    selectNetwork(n, k, kernel, tile);
+}
+
+// The same flip network for a fixed power-of-two N, laid out at compile time: pairs()
+// lists every compare-exchange in network order, and run() expands them into straight-
+// line code with constant indices, so small sorts pay neither loop control nor index
+// arithmetic. Intended for N up to 64 (N/2 * log N * (log N + 1) / 2 comparators).
+// mergePairs() and runMerge() do the same for the half-cleaners of mergeNetwork.
+template <size_t N>
+struct FixedNetwork {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "FixedNetwork needs a power-of-two size.");
+
+    struct Pair {
+        uint16_t lo;
+        uint16_t hi;
+    };
+
+    static constexpr size_t log2N() {
+        size_t lg = 0;
+        while ((size_t(1) << lg) < N)
+            lg++;
+        return lg;
+    }
+
+    static constexpr size_t size = N / 2 * log2N() * (log2N() + 1) / 2;
+
+    static constexpr std::array<Pair, size> pairs() {
+        std::array<Pair, size> out{};
+        size_t c = 0;
+        for (size_t k = 2; k <= N; k *= 2) {
+            for (size_t b = 0; b < N; b += k)
+                for (size_t t = 0; t < k / 2; t++)
+                    out[c++] = Pair{ uint16_t(b + t), uint16_t(b + k - 1 - t) };
+            for (size_t d = k / 4; d > 0; d /= 2)
+                for (size_t b = 0; b < N; b += 2 * d)
+                    for (size_t t = 0; t < d; t++)
+                        out[c++] = Pair{ uint16_t(b + t), uint16_t(b + d + t) };
+        }
+        return out;
+    }
+
+    static constexpr size_t merge_size = N / 2 * log2N();
+
+    static constexpr std::array<Pair, merge_size> mergePairs() {
+        std::array<Pair, merge_size> out{};
+        size_t c = 0;
+        for (size_t d = N / 2; d > 0; d /= 2)
+            for (size_t b = 0; b < N; b += 2 * d)
+                for (size_t t = 0; t < d; t++)
+                    out[c++] = Pair{ uint16_t(b + t), uint16_t(b + d + t) };
+        return out;
+    }
+
+    // Calls exchange(lo, hi) for every pair in order; lo must receive the element that
+    // comes first.
+    template <class Exchange>
+    static void run(Exchange&& exchange) {
+        runPairs(exchange, std::make_index_sequence<size>());
+    }
+
+    // Same for the merge of a bitonic sequence of N.
+    template <class Exchange>
+    static void runMerge(Exchange&& exchange) {
+        runMergePairs(exchange, std::make_index_sequence<merge_size>());
+    }
+
+private:
+    static constexpr std::array<Pair, size> table = pairs();
+    static constexpr std::array<Pair, merge_size> merge_table = mergePairs();
+
+    template <class Exchange, size_t... I>
+    static void runPairs(Exchange& exchange, std::index_sequence<I...>) {
+        (exchange(std::integral_constant<size_t, table[I].lo>(), std::integral_constant<size_t, table[I].hi>()), ...);
+    }
+
+    template <class Exchange, size_t... I>
+    static void runMergePairs(Exchange& exchange, std::index_sequence<I...>) {
+        (exchange(std::integral_constant<size_t, merge_table[I].lo>(),
+                  std::integral_constant<size_t, merge_table[I].hi>()), ...);
+    }
+};
+
+} // namespace bitonic
+
+#endif // BITONIC_NETWORK_H
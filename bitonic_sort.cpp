@@ -1,51 +1,35 @@
 // main_bitonic_sort.cpp
 #include <iostream>
-#include <fstream>
 #include <vector>
 #include <random>
 #include <algorithm>
 #include <cmath>
 #include <thread>
-#include "nlohmann/json.hpp"
+#include <string>
 #include "oblivious_sort.h"
+#include "bulk_loader.h"
 
-using json = nlohmann::json;
+int main(int argc, char** argv) {
+    // Usage: bitonic_sort [input = ints.json] [output = sorted_output_bitonic.json]
+    std::string input = argc > 1 ? argv[1] : "ints.json";
+    std::string output = argc > 2 ? argv[2] : "sorted_output_bitonic.json";
 
-// Helper: Compute next power of two.
-size_t nextPowerOfTwo(size_t n) {
-    if (n == 0) return 1;
-    size_t power = 1;
-    while (power < n) {
-        power *= 2;
-    }
-    return power;
-}
-
-int main() {
-    // Open ints.json
-    std::ifstream ifs("ints.json");
-    if (!ifs.is_open()) {
-        std::cerr << "Error: Could not open ints.json\n";
-        return 1;
-    }
-    
-    // Parse JSON into vector of integers.
-    json j;
+    // Load the integers (JSON array, one per line, or binary).
+    std::vector<int> inputValues;
     try {
-        ifs >> j;
+        inputValues = loadIntArray(input);
     }
     catch (const std::exception& e) {
-        std::cerr << "JSON parse error: " << e.what() << "\n";
+        std::cerr << "Error: " << e.what() << "\n";
         return 1;
     }
-    std::vector<int> inputValues = j.get<std::vector<int>>();
-    std::cout << "Loaded " << inputValues.size() << " integers from ints.json.\n";
+    std::cout << "Loaded " << inputValues.size() << " integers from " << input << ".\n";
     
     // Convert integers to Elements.
-    std::vector<Element> elements;
+    std::vector<BasicElement<int>> elements;
     elements.reserve(inputValues.size());
     for (int val : inputValues) {
-        Element e;
+        BasicElement<int> e;
         e.value = val;
         // For bitonic sort, we want key to reflect the value.
         e.key = val;
@@ -53,19 +37,8 @@ int main() {
         elements.push_back(e);
     }
     
-    // Pad the vector to next power of two.
-    size_t origSize = elements.size();
-    size_t paddedSize = nextPowerOfTwo(origSize);
-    if (paddedSize > origSize) {
-        for (size_t i = origSize; i < paddedSize; i++) {
-            Element dummy;
-            dummy.value = 0;
-            dummy.key = 0;
-            dummy.is_dummy = true;
-            elements.push_back(dummy);
-        }
-    }
-    std::cout << "Padded vector size for bitonic sort: " << elements.size() << "\n";
+    // No padding needed: the bitonic network handles any length.
+    std::cout << "Bitonic sort input size: " << elements.size() << "\n";
     
     // Create an Enclave.
     UntrustedMemory dummyUntrusted;
@@ -76,9 +49,13 @@ int main() {
         enclave.bitonicSort(elements, 0, elements.size(), true);
     });
     sortThread.join();
+    const TrustedMemory& epc = enclave.trusted_memory;
+    std::cout << "Trusted working set peak " << epc.peakBytes() << " bytes of " << epc.config().budget_bytes
+              << " EPC; simulated paging " << epc.pageIns() << " page-ins, " << epc.pageOuts()
+              << " page-outs, " << epc.pagingMs() << " ms\n";
     
     // Remove dummy elements.
-    std::vector<Element> finalElements;
+    std::vector<BasicElement<int>> finalElements;
     for (const auto &e : elements) {
         if (!e.is_dummy)
             finalElements.push_back(e);
@@ -86,22 +63,24 @@ int main() {
     
     // Verify sorted order by value.
     bool sorted = std::is_sorted(finalElements.begin(), finalElements.end(), 
-        [](const Element& a, const Element& b) {
+        [](const BasicElement<int>& a, const BasicElement<int>& b) {
             return a.value < b.value;
         });
     std::cout << "Final elements sorted by value? " << (sorted ? "Yes" : "No") << "\n";
     
     // Write sorted integers to file.
-    std::ofstream ofs("sorted_output_bitonic.json");
-    if (!ofs.is_open()) {
-        std::cerr << "Error: Could not open sorted_output_bitonic.json for writing\n";
-        return 1;
+    std::vector<int> sortedValues;
+    sortedValues.reserve(finalElements.size());
+    for (const auto &e : finalElements)
+        sortedValues.push_back(e.value);
+    try {
+        writeIntArray(output, sortedValues, formatForPath(output));
     }
-    for (const auto &e : finalElements) {
-        ofs << e.value << "\n";
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
     }
-    ofs.close();
-    std::cout << "Wrote sorted_output_bitonic.json\n";
+    std::cout << "Wrote " << output << "\n";
     
     return 0;
 }
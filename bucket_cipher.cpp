@@ -0,0 +1,349 @@
+#include "bucket_cipher.h"
+#include <cstring>
+#include <random>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BUCKET_CIPHER_X86 1
+#else
+#define BUCKET_CIPHER_X86 0
+#endif
+
+// ----- XorCipher Methods -----
+void XorCipher::seal(const uint8_t* src, uint8_t* dst, size_t len,
+                     const uint8_t* /*aad*/, size_t /*aad_len*/, BucketSeal& seal) {
+    uint64_t wide = (static_cast<uint64_t>(key) << 32) | key;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, src + i, 8);
+        word ^= wide;
+        std::memcpy(dst + i, &word, 8);
+    }
+    uint8_t pad[4];
+    std::memcpy(pad, &key, sizeof(pad));
+    for (; i < len; i++)
+        dst[i] = src[i] ^ pad[i & 3];
+    std::memset(&seal, 0, sizeof(seal));
+}
+
+void XorCipher::open(const uint8_t* src, uint8_t* dst, size_t len,
+                     const uint8_t* aad, size_t aad_len, const BucketSeal& /*seal*/) {
+    BucketSeal unused;
+    seal(src, dst, len, aad, aad_len, unused);
+}
+
+// ----- AesGcmCipher Methods -----
+#if BUCKET_CIPHER_X86
+
+#define AESGCM_TARGET __attribute__((target("aes,pclmul,ssse3")))
+
+namespace {
+
+AESGCM_TARGET inline __m128i byteReverse(__m128i x) {
+    return _mm_shuffle_epi8(x, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+}
+
+AESGCM_TARGET inline __m128i load(const uint8_t* p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+AESGCM_TARGET inline void store(uint8_t* p, __m128i v) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+}
+
+// Loads up to 16 bytes, zero-padded.
+AESGCM_TARGET inline __m128i loadPartial(const uint8_t* p, size_t n) {
+    alignas(16) uint8_t block[16] = {};
+    std::memcpy(block, p, n);
+    return load(block);
+}
+
+// Carry-less 128x128 -> 256-bit multiply, accumulated into (lo, hi) without reduction,
+// so several products can share one reduction (aggregated GHASH).
+AESGCM_TARGET inline void clmulAccumulate(__m128i a, __m128i b, __m128i& lo, __m128i& hi) {
+    __m128i t0 = _mm_clmulepi64_si128(a, b, 0x00);
+    __m128i t1 = _mm_clmulepi64_si128(a, b, 0x10);
+    __m128i t2 = _mm_clmulepi64_si128(a, b, 0x01);
+    __m128i t3 = _mm_clmulepi64_si128(a, b, 0x11);
+    t1 = _mm_xor_si128(t1, t2);
+    lo = _mm_xor_si128(lo, _mm_xor_si128(t0, _mm_slli_si128(t1, 8)));
+    hi = _mm_xor_si128(hi, _mm_xor_si128(t3, _mm_srli_si128(t1, 8)));
+}
+
+// Reduces a 256-bit product of byte-reflected operands modulo the GCM polynomial
+// (shift left by one bit, then fold; Gueron & Kounavis, Intel CLMUL white paper).
+AESGCM_TARGET inline __m128i reduce(__m128i lo, __m128i hi) {
+    __m128i t7 = _mm_srli_epi32(lo, 31);
+    __m128i t8 = _mm_srli_epi32(hi, 31);
+    lo = _mm_slli_epi32(lo, 1);
+    hi = _mm_slli_epi32(hi, 1);
+    __m128i t9 = _mm_srli_si128(t7, 12);
+    t8 = _mm_slli_si128(t8, 4);
+    t7 = _mm_slli_si128(t7, 4);
+    lo = _mm_or_si128(lo, t7);
+    hi = _mm_or_si128(_mm_or_si128(hi, t8), t9);
+
+    t7 = _mm_slli_epi32(lo, 31);
+    t8 = _mm_slli_epi32(lo, 30);
+    t9 = _mm_slli_epi32(lo, 25);
+    t7 = _mm_xor_si128(_mm_xor_si128(t7, t8), t9);
+    t8 = _mm_srli_si128(t7, 4);
+    t7 = _mm_slli_si128(t7, 12);
+    lo = _mm_xor_si128(lo, t7);
+
+    __m128i t2 = _mm_srli_epi32(lo, 1);
+    __m128i t4 = _mm_srli_epi32(lo, 2);
+    __m128i t5 = _mm_srli_epi32(lo, 7);
+    t2 = _mm_xor_si128(_mm_xor_si128(t2, t4), _mm_xor_si128(t5, t8));
+    lo = _mm_xor_si128(lo, t2);
+    return _mm_xor_si128(hi, lo);
+}
+
+AESGCM_TARGET inline __m128i gfMultiply(__m128i a, __m128i b) {
+    __m128i lo = _mm_setzero_si128();
+    __m128i hi = _mm_setzero_si128();
+    clmulAccumulate(a, b, lo, hi);
+    return reduce(lo, hi);
+}
+
+AESGCM_TARGET inline __m128i expandStep(__m128i key, __m128i assist) {
+    assist = _mm_shuffle_epi32(assist, 0xff);
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    return _mm_xor_si128(key, assist);
+}
+
+AESGCM_TARGET inline __m128i encryptBlock(const __m128i* rk, __m128i x) {
+    x = _mm_xor_si128(x, rk[0]);
+    for (int r = 1; r < 10; r++)
+        x = _mm_aesenc_si128(x, rk[r]);
+    return _mm_aesenclast_si128(x, rk[10]);
+}
+
+struct GcmState {
+    __m128i rk[11];
+    __m128i h[8];  // h[k] = H^(k+1), byte-reflected.
+    __m128i x;     // GHASH accumulator, byte-reflected.
+};
+
+AESGCM_TARGET inline void ghashBlock(GcmState& s, __m128i reflected) {
+    s.x = gfMultiply(_mm_xor_si128(s.x, reflected), s.h[0]);
+}
+
+// Folds eight consecutive blocks with a single reduction:
+// X' = (X ^ B0) * H^8 ^ B1 * H^7 ^ ... ^ B7 * H.
+AESGCM_TARGET inline void ghash8(GcmState& s, const __m128i* blocks) {
+    __m128i lo = _mm_setzero_si128();
+    __m128i hi = _mm_setzero_si128();
+    clmulAccumulate(_mm_xor_si128(s.x, byteReverse(blocks[0])), s.h[7], lo, hi);
+    for (int k = 1; k < 8; k++)
+        clmulAccumulate(byteReverse(blocks[k]), s.h[7 - k], lo, hi);
+    s.x = reduce(lo, hi);
+}
+
+AESGCM_TARGET void ghashBytes(GcmState& s, const uint8_t* p, size_t len) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16)
+        ghashBlock(s, byteReverse(load(p + i)));
+    if (i < len)
+        ghashBlock(s, byteReverse(loadPartial(p + i, len - i)));
+}
+
+// Shared encrypt/decrypt path. GHASH always runs over the ciphertext: after the XOR when
+// encrypting, before it when decrypting, so src and dst may alias.
+AESGCM_TARGET void gcmCrypt(const uint8_t round_keys[11][16], const uint8_t h_powers[8][16],
+                            const uint8_t nonce[12], const uint8_t* src, uint8_t* dst, size_t len,
+                            const uint8_t* aad, size_t aad_len, bool decrypt, uint8_t tag[16]) {
+    GcmState s;
+    for (int r = 0; r < 11; r++)
+        s.rk[r] = load(round_keys[r]);
+    for (int k = 0; k < 8; k++)
+        s.h[k] = load(h_powers[k]);
+    s.x = _mm_setzero_si128();
+
+    alignas(16) uint8_t j0_bytes[16];
+    std::memcpy(j0_bytes, nonce, 12);
+    j0_bytes[12] = 0;
+    j0_bytes[13] = 0;
+    j0_bytes[14] = 0;
+    j0_bytes[15] = 1;
+    __m128i j0 = load(j0_bytes);
+    // Byte-reversed, the big-endian 32-bit block counter sits in the low lane.
+    __m128i counter = byteReverse(j0);
+    const __m128i one = _mm_set_epi32(0, 0, 0, 1);
+
+    ghashBytes(s, aad, aad_len);
+
+    size_t i = 0;
+    for (; i + 128 <= len; i += 128) {
+        __m128i ks[8];
+        __m128i in[8];
+        for (int k = 0; k < 8; k++) {
+            counter = _mm_add_epi32(counter, one);
+            ks[k] = _mm_xor_si128(byteReverse(counter), s.rk[0]);
+        }
+        for (int r = 1; r < 10; r++)
+            for (int k = 0; k < 8; k++)
+                ks[k] = _mm_aesenc_si128(ks[k], s.rk[r]);
+        for (int k = 0; k < 8; k++) {
+            ks[k] = _mm_aesenclast_si128(ks[k], s.rk[10]);
+            in[k] = load(src + i + 16 * k);
+        }
+        if (decrypt)
+            ghash8(s, in);
+        for (int k = 0; k < 8; k++) {
+            in[k] = _mm_xor_si128(in[k], ks[k]);
+            store(dst + i + 16 * k, in[k]);
+        }
+        if (!decrypt)
+            ghash8(s, in);
+    }
+    for (; i < len; i += 16) {
+        size_t n = len - i < 16 ? len - i : 16;
+        counter = _mm_add_epi32(counter, one);
+        __m128i ks = encryptBlock(s.rk, byteReverse(counter));
+        alignas(16) uint8_t block[16] = {};
+        std::memcpy(block, src + i, n);
+        __m128i in = load(block);
+        if (decrypt)
+            ghashBlock(s, byteReverse(in));
+        __m128i out = _mm_xor_si128(in, ks);
+        store(block, out);
+        std::memset(block + n, 0, 16 - n);
+        std::memcpy(dst + i, block, n);
+        if (!decrypt)
+            ghashBlock(s, byteReverse(load(block)));
+    }
+
+    // Length block: bit lengths of AAD and ciphertext, big-endian.
+    alignas(16) uint8_t lengths[16];
+    uint64_t aad_bits = static_cast<uint64_t>(aad_len) * 8;
+    uint64_t data_bits = static_cast<uint64_t>(len) * 8;
+    for (int b = 0; b < 8; b++) {
+        lengths[b] = static_cast<uint8_t>(aad_bits >> (56 - 8 * b));
+        lengths[8 + b] = static_cast<uint8_t>(data_bits >> (56 - 8 * b));
+    }
+    ghashBlock(s, byteReverse(load(lengths)));
+
+    store(tag, _mm_xor_si128(encryptBlock(s.rk, j0), byteReverse(s.x)));
+}
+
+AESGCM_TARGET void expandAesKey(const uint8_t key[16], uint8_t round_keys[11][16], uint8_t h_powers[8][16]) {
+    __m128i rk[11];
+    rk[0] = load(key);
+    rk[1] = expandStep(rk[0], _mm_aeskeygenassist_si128(rk[0], 0x01));
+    rk[2] = expandStep(rk[1], _mm_aeskeygenassist_si128(rk[1], 0x02));
+    rk[3] = expandStep(rk[2], _mm_aeskeygenassist_si128(rk[2], 0x04));
+    rk[4] = expandStep(rk[3], _mm_aeskeygenassist_si128(rk[3], 0x08));
+    rk[5] = expandStep(rk[4], _mm_aeskeygenassist_si128(rk[4], 0x10));
+    rk[6] = expandStep(rk[5], _mm_aeskeygenassist_si128(rk[5], 0x20));
+    rk[7] = expandStep(rk[6], _mm_aeskeygenassist_si128(rk[6], 0x40));
+    rk[8] = expandStep(rk[7], _mm_aeskeygenassist_si128(rk[7], 0x80));
+    rk[9] = expandStep(rk[8], _mm_aeskeygenassist_si128(rk[8], 0x1b));
+    rk[10] = expandStep(rk[9], _mm_aeskeygenassist_si128(rk[9], 0x36));
+    for (int r = 0; r < 11; r++)
+        store(round_keys[r], rk[r]);
+
+    // H = E(K, 0^128); precompute H^1 .. H^8 for the aggregated GHASH.
+    __m128i h = byteReverse(encryptBlock(rk, _mm_setzero_si128()));
+    __m128i power = h;
+    for (int k = 0; k < 8; k++) {
+        store(h_powers[k], power);
+        power = gfMultiply(power, h);
+    }
+}
+
+} // namespace
+
+bool AesGcmCipher::supported() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("aes") && __builtin_cpu_supports("pclmul");
+}
+
+void AesGcmCipher::expandKey(const uint8_t key[16]) {
+    if (!supported())
+        throw std::runtime_error("AES-GCM requires AES-NI and PCLMULQDQ.");
+    expandAesKey(key, round_keys, h_powers);
+}
+
+void AesGcmCipher::encryptWithNonce(const uint8_t nonce[12], const uint8_t* src, uint8_t* dst, size_t len,
+                                    const uint8_t* aad, size_t aad_len, uint8_t tag[16]) const {
+    gcmCrypt(round_keys, h_powers, nonce, src, dst, len, aad, aad_len, false, tag);
+}
+
+void AesGcmCipher::open(const uint8_t* src, uint8_t* dst, size_t len,
+                        const uint8_t* aad, size_t aad_len, const BucketSeal& seal) {
+    uint8_t tag[16];
+    gcmCrypt(round_keys, h_powers, seal.nonce, src, dst, len, aad, aad_len, true, tag);
+    // Constant-time tag comparison.
+    uint8_t diff = 0;
+    for (int b = 0; b < 16; b++)
+        diff |= tag[b] ^ seal.tag[b];
+    if (diff != 0)
+        throw std::runtime_error("Bucket authentication failed.");
+}
+
+#else // !BUCKET_CIPHER_X86
+
+bool AesGcmCipher::supported() {
+    return false;
+}
+
+void AesGcmCipher::expandKey(const uint8_t* /*key*/) {
+    throw std::runtime_error("AES-GCM requires AES-NI and PCLMULQDQ.");
+}
+
+void AesGcmCipher::encryptWithNonce(const uint8_t*, const uint8_t*, uint8_t*, size_t,
+                                    const uint8_t*, size_t, uint8_t*) const {
+    throw std::runtime_error("AES-GCM requires AES-NI and PCLMULQDQ.");
+}
+
+void AesGcmCipher::open(const uint8_t*, uint8_t*, size_t, const uint8_t*, size_t, const BucketSeal&) {
+    throw std::runtime_error("AES-GCM requires AES-NI and PCLMULQDQ.");
+}
+
+#endif // BUCKET_CIPHER_X86
+
+AesGcmCipher::AesGcmCipher() {
+    std::random_device rd;
+    uint8_t key[16];
+    for (int b = 0; b < 16; b += 4) {
+        uint32_t word = rd();
+        std::memcpy(key + b, &word, 4);
+    }
+    nonce_prefix = rd();
+    expandKey(key);
+}
+
+AesGcmCipher::AesGcmCipher(const uint8_t key[16]) {
+    std::random_device rd;
+    nonce_prefix = rd();
+    expandKey(key);
+}
+
+void AesGcmCipher::seal(const uint8_t* src, uint8_t* dst, size_t len,
+                        const uint8_t* aad, size_t aad_len, BucketSeal& seal) {
+    // Per-write nonce: 32-bit instance prefix || 64-bit counter.
+    uint64_t count = nonce_counter.fetch_add(1, std::memory_order_relaxed);
+    for (int b = 0; b < 4; b++)
+        seal.nonce[b] = static_cast<uint8_t>(nonce_prefix >> (24 - 8 * b));
+    for (int b = 0; b < 8; b++)
+        seal.nonce[4 + b] = static_cast<uint8_t>(count >> (56 - 8 * b));
+    encryptWithNonce(seal.nonce, src, dst, len, aad, aad_len, seal.tag);
+}
+
+std::unique_ptr<BucketCipher> makeBucketCipher(CipherKind kind) {
+    switch (kind) {
+    case CipherKind::AesGcm:
+        return std::make_unique<AesGcmCipher>();
+    default:
+        return std::make_unique<XorCipher>(0xdeadbeef);
+    }
+}
+
+const char* cipherKindName(CipherKind kind) {
+    return kind == CipherKind::AesGcm ? "aes-128-gcm" : "xor";
+}
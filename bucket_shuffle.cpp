@@ -0,0 +1,130 @@
+#include "bucket_shuffle.h"
+#include "compare_exchange.h"
+#include <vector>
+#include <algorithm>
+
+namespace {
+
+// Per-thread scratch, reused across buckets. As in merge_split.cpp, the tags go through
+// the networks themselves: word i carries the key of tag i in its low 32 bits and rest[i]
+// its payload and dummy flag, so no tag moves to or from a secret position.
+thread_local std::vector<uint64_t> words;
+thread_local std::vector<uint64_t> rest;
+thread_local std::vector<uint64_t> masks;
+thread_local std::vector<uint32_t> labels;
+
+void packRest(const ElementTag* bucket, size_t Z) {
+    rest.resize(Z);
+    for (size_t i = 0; i < Z; i++)
+        rest[i] = uint64_t(bucket[i].payload) | uint64_t(bucket[i].is_dummy) << 32;
+}
+
+void unpackTags(ElementTag* bucket, size_t Z) {
+    for (size_t i = 0; i < Z; i++)
+        bucket[i] = ElementTag{ static_cast<int>(static_cast<uint32_t>(words[i])),
+                                static_cast<uint32_t>(rest[i]), static_cast<uint32_t>(rest[i] >> 32) };
+}
+
+size_t labelSort(ElementTag* bucket, size_t Z, CounterRng& rng) {
+    // Word layout: dummy << 63 | 31-bit label << 32 | key. Ascending order puts the reals
+    // first, in label order.
+    labels.resize(Z);
+    rng.fill(labels.data(), Z);
+    words.resize(Z);
+    size_t count = 0;
+    for (size_t i = 0; i < Z; i++) {
+        uint64_t dummy = bucket[i].is_dummy;
+        uint64_t label = labels[i] >> 1;
+        words[i] = (dummy << 63) | (label << 32) | static_cast<uint32_t>(bucket[i].key);
+        count += 1 - dummy;
+    }
+    packRest(bucket, Z);
+    cmpex::sortKeyValue(words.data(), rest.data(), Z, true);
+    return count;
+}
+
+size_t switchNetwork(ElementTag* bucket, size_t Z, CounterRng& rng) {
+    // Word layout through the network: dummy << 32 | key.
+    words.resize(Z);
+    for (size_t i = 0; i < Z; i++)
+        words[i] = (uint64_t(bucket[i].is_dummy) << 32) | static_cast<uint32_t>(bucket[i].key);
+    packRest(bucket, Z);
+
+    // Strides 1, 2, ..., 2^(m-1), ..., 2, 1 as in a Benes network on 2^m >= Z slots; the
+    // switches that would reach past Z are left out. Each switch swaps its pair when its
+    // random bit is set, with a mask rather than a branch; a stage's masks are drawn
+    // first so that the swaps run as one vectorizable loop per block.
+    unsigned m = 0;
+    while ((size_t(1) << m) < Z)
+        m++;
+    masks.resize(Z);
+    uint64_t* __restrict w = words.data();
+    uint64_t* __restrict r = rest.data();
+    uint64_t* __restrict mask = masks.data();
+    for (unsigned stage = 0; m > 0 && stage < 2 * m - 1; stage++) {
+        size_t step = size_t(1) << (stage < m ? stage : 2 * m - 2 - stage);
+        for (size_t i = 0; i < Z; i += 64) {
+            uint64_t bits = rng.next64();
+            size_t end = std::min<size_t>(64, Z - i);
+            for (size_t j = 0; j < end; j++)
+                mask[i + j] = 0 - ((bits >> j) & 1);
+        }
+        for (size_t base = 0; base + step < Z; base += 2 * step) {
+            size_t end = std::min(base + step, Z - step);
+            for (size_t i = base; i < end; i++) {
+                uint64_t a = w[i];
+                uint64_t b = w[i + step];
+                uint64_t d = (a ^ b) & mask[i];
+                uint64_t rd = (r[i] ^ r[i + step]) & mask[i];
+                w[i] = a ^ d;
+                w[i + step] = b ^ d;
+                r[i] ^= rd;
+                r[i + step] ^= rd;
+            }
+        }
+    }
+
+    // Reals move left by the number of dummies before them (cmpex::compactWords layout).
+    size_t count = 0;
+    for (size_t i = 0; i < Z; i++) {
+        uint64_t marked = 1 - (words[i] >> 32);
+        uint64_t distance = (i - count) & (0 - marked);
+        words[i] = (distance << 33) | (marked << 32) | static_cast<uint32_t>(words[i]);
+        count += marked;
+    }
+    cmpex::compactKeyValue(words.data(), rest.data(), Z);
+    return count;
+}
+
+} // namespace
+
+const char* bucketShuffleName(BucketShuffle shuffle) {
+    switch (shuffle) {
+    case BucketShuffle::SwitchNetwork: return "switch-network";
+    default: return "label-sort";
+    }
+}
+
+const char* bucketShuffleGuarantee(BucketShuffle shuffle) {
+    switch (shuffle) {
+    case BucketShuffle::SwitchNetwork:
+        return "Fixed pattern of conditional swaps. The permutation is random but not exactly "
+               "uniform: no network of random switches on more than two slots is.";
+    default:
+        return "Fixed pattern of compare-exchanges. Uniform permutation of the reals, up to "
+               "ties among 31-bit labels (broken by key).";
+    }
+}
+
+size_t shuffleScratchBytes(size_t Z) {
+    // words, rest, and labels or masks.
+    return Z * 3 * sizeof(uint64_t);
+}
+
+size_t shuffleBucket(ElementTag* bucket, size_t Z, CounterRng& rng, BucketShuffle shuffle) {
+    size_t count = shuffle == BucketShuffle::SwitchNetwork ? switchNetwork(bucket, Z, rng)
+                                                           : labelSort(bucket, Z, rng);
+    unpackTags(bucket, Z);
+    std::fill(bucket + count, bucket + Z, ElementTag{ 0, 0, 1 });
+    return count;
+}
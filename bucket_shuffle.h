@@ -0,0 +1,32 @@
+#ifndef BUCKET_SHUFFLE_H
+#define BUCKET_SHUFFLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include "element_store.h"
+#include "counter_rng.h"
+
+// Oblivious permutation and compaction of one final bucket: after the butterfly network
+// the real tags of a bucket are in an order that still reflects the input order, so they
+// are permuted at random before the final sort looks at their values, and the dummies are
+// dropped. Both engines move the tags themselves, as (flags, key) words beside their
+// payload words, through a fixed sequence of conditional swaps.
+enum class BucketShuffle {
+    LabelSort,     // Bitonic sort on (dummy, random label): O(Z log^2 Z), a uniform permutation.
+    SwitchNetwork  // Benes-pattern network of random switches, then compaction: O(Z log Z).
+};
+
+const char* bucketShuffleName(BucketShuffle shuffle);
+
+// Describes the permutation each engine produces.
+const char* bucketShuffleGuarantee(BucketShuffle shuffle);
+
+// Permutes bucket[0, Z) with random bits drawn from rng and moves the real tags to the
+// front, in their new order; returns how many there are. bucket[count, Z) is left as
+// dummies.
+size_t shuffleBucket(ElementTag* bucket, size_t Z, CounterRng& rng, BucketShuffle shuffle);
+
+// Per-thread scratch shuffleBucket holds for a bucket of Z tags, in bytes.
+size_t shuffleScratchBytes(size_t Z);
+
+#endif // BUCKET_SHUFFLE_H
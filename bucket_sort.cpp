@@ -1,52 +1,69 @@
 // main_oblivious_bucket_sort.cpp
 #include <iostream>
-#include <fstream>
 #include <vector>
-#include "nlohmann/json.hpp"
+#include <string>
 #include "oblivious_sort.h"
+#include "bulk_loader.h"
 
-using json = nlohmann::json;
+int main(int argc, char** argv) {
+    // Usage: bucket_sort [input = ints.json] [output = sorted_output_oblivious.json] [bucket_size = auto]
+    std::string input = argc > 1 ? argv[1] : "ints.json";
+    std::string output = argc > 2 ? argv[2] : "sorted_output_oblivious.json";
+    // A fixed bucket size, or auto to let the enclave pick Z and B for the input.
+    std::string bucket_arg = argc > 3 ? argv[3] : "auto";
 
-int main() {
-    // Open ints.json
-    std::ifstream ifs("ints.json");
-    if (!ifs.is_open()) {
-        std::cerr << "Error: Could not open ints.json\n";
-        return 1;
-    }
-    
-    // Parse JSON into a vector of integers.
-    json j;
+    // Load the integers (JSON array, one per line, or binary).
+    std::vector<int> inputValues;
     try {
-        ifs >> j;
+        inputValues = loadIntArray(input);
     }
     catch (const std::exception& e) {
-        std::cerr << "JSON parse error: " << e.what() << "\n";
+        std::cerr << "Error: " << e.what() << "\n";
         return 1;
     }
-    std::vector<int> inputValues = j.get<std::vector<int>>();
-    std::cout << "Loaded " << inputValues.size() << " integers from ints.json.\n";
+    std::cout << "Loaded " << inputValues.size() << " integers from " << input << ".\n";
     
-    // Create an UntrustedMemory and Enclave.
-    UntrustedMemory untrusted;
-    Enclave enclave(&untrusted);
+    // Create the untrusted bucket storage (flat, preallocated arena) and Enclave. A bucket
+    // overflow restarts the network with fresh keys instead of failing the sort.
+    FlatUntrustedMemory untrusted;
+    EnclaveConfig config;
+    config.overflow_policy = OverflowPolicy::Reseed;
+    Enclave enclave(&untrusted, config);
     
-    // Choose a bucket size (experiment with this value, e.g. 32 or 64).
-    int bucket_size = 32;
-    std::cout << "Starting oblivious bucket sort with bucket size " << bucket_size << "...\n";
+    int bucket_size = bucket_arg == "auto" ? kAutoBucketSize : std::stoi(bucket_arg);
+    std::cout << "Starting oblivious bucket sort with bucket size " << bucket_arg << "...\n";
     
-    std::vector<int> sortedOblivious = enclave.oblivious_sort(inputValues, bucket_size);
-    
-    std::ofstream ofs("sorted_output_oblivious.json");
-    if (!ofs.is_open()) {
-        std::cerr << "Error: Could not open sorted_output_oblivious.json for writing\n";
+    std::vector<int> sortedOblivious;
+    try {
+        sortedOblivious = enclave.oblivious_sort(inputValues, bucket_size);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
         return 1;
     }
-    for (int val : sortedOblivious) {
-        ofs << val << "\n";
+    const BucketParameters& plan = enclave.last_parameters;
+    std::cout << "Z = " << plan.Z << ", B = " << plan.B << ", L = " << plan.L
+              << ", padded slots " << plan.paddedSlots() << ", overflow probability <= "
+              << plan.failure_probability;
+    if (plan.predicted_ms > 0)
+        std::cout << ", predicted network time " << plan.predicted_ms << " ms";
+    std::cout << "\n";
+    if (enclave.overflow_stats.overflows > 0)
+        std::cout << "Bucket overflows: " << enclave.overflow_stats.overflows << ", restarted "
+                  << enclave.overflow_stats.reseeds << " times\n";
+    const TrustedMemory& epc = enclave.trusted_memory;
+    std::cout << "Trusted working set peak " << epc.peakBytes() << " bytes of " << epc.config().budget_bytes
+              << " EPC; simulated paging " << epc.pageIns() << " page-ins, " << epc.pageOuts()
+              << " page-outs, " << epc.pagingMs() << " ms\n";
+    
+    try {
+        writeIntArray(output, sortedOblivious, formatForPath(output));
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
     }
-    ofs.close();
-    std::cout << "Wrote sorted_output_oblivious.json\n";
+    std::cout << "Wrote " << output << "\n";
     
     return 0;
 }
@@ -0,0 +1,174 @@
+#include "bucket_tuning.h"
+#include "compare_exchange.h"
+#include <cmath>
+#include <map>
+#include <tuple>
+#include <mutex>
+#include <chrono>
+#include <random>
+#include <limits>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+
+// ----- Overflow Probability -----
+// P[X > Z] for X ~ Binomial(N, p), summed in log space from Z + 1 up until the terms
+// stop contributing. Z + 1 is past the mode, so the terms only shrink from there: once
+// one underflows to zero or drops below the precision of the sum, so does the rest.
+static double binomialTailAbove(double N, double p, int Z) {
+    if (Z >= N)
+        return 0;
+    if (Z + 1 <= N * p)
+        return 1;  // Z is at or below the mean; treat the bucket as overflowing.
+    double log_p = std::log(p);
+    double log_q = std::log1p(-p);
+    double log_norm = std::lgamma(N + 1);
+    double sum = 0;
+    for (double k = Z + 1; k <= N; k++) {
+        double term = std::exp(log_norm - std::lgamma(k + 1) - std::lgamma(N - k + 1) + k * log_p + (N - k) * log_q);
+        sum += term;
+        if (term == 0 || term < sum * 1e-17)
+            break;
+    }
+    return std::min(1.0, sum);
+}
+
+double overflowProbability(int n, int B, int Z) {
+    double load = std::ceil(static_cast<double>(n) / B);
+    if (load > Z)
+        return 1;
+    double total = 0;
+    for (int width = 2; width <= B; width *= 2) {
+        double gathered = std::min(static_cast<double>(n), load * width);
+        total += B * binomialTailAbove(gathered, 1.0 / width, Z);
+        if (total >= 1)
+            return 1;
+    }
+    return total;
+}
+
+// ----- BucketCostModel Methods -----
+BucketCostModel::BucketCostModel(std::vector<Sample> samples) : table(std::move(samples)) {
+    if (table.empty())
+        throw std::invalid_argument("Cost model needs at least one sample.");
+    std::sort(table.begin(), table.end(), [](const Sample& a, const Sample& b) { return a.Z < b.Z; });
+}
+
+// Runs fn repeatedly for at least a millisecond and returns its mean time in ns.
+template <class Fn>
+static double meanNs(Fn&& fn) {
+    using clock = std::chrono::steady_clock;
+    fn();  // Warm up.
+    size_t reps = 0;
+    auto start = clock::now();
+    auto stop = start;
+    while (reps < 3 || stop - start < std::chrono::milliseconds(1)) {
+        fn();
+        reps++;
+        stop = clock::now();
+    }
+    return std::chrono::duration<double, std::nano>(stop - start).count() / reps;
+}
+
+BucketCostModel BucketCostModel::calibrate(CipherKind cipher_kind, MergeSplitEngine engine, BucketShuffle shuffle) {
+    std::unique_ptr<BucketCipher> cipher = makeBucketCipher(cipher_kind);
+    std::mt19937 gen(1);
+    std::vector<Sample> samples;
+    for (int Z = 4; Z <= 4096; Z *= 2) {
+        // A pair at half load with keys split evenly on bit 0, so it never overflows.
+        std::vector<ElementTag> combined(2 * static_cast<size_t>(Z));
+        for (size_t i = 0; i < combined.size(); i++)
+            combined[i] = ElementTag{ static_cast<int>(gen() & ~1u) | static_cast<int>(i / 2 % 2),
+                                      static_cast<uint32_t>(i), static_cast<uint32_t>(i % 2) };
+        std::vector<ElementTag> sealed(combined.size());
+        BucketSeal seals[2];
+        uint8_t aad[16] = {};  // The size of a bucket's associated data.
+        size_t bucket_bytes = Z * sizeof(ElementTag);
+        auto* plain = reinterpret_cast<uint8_t*>(combined.data());
+        auto* stored = reinterpret_cast<uint8_t*>(sealed.data());
+        for (int b = 0; b < 2; b++)
+            cipher->seal(plain + b * bucket_bytes, stored + b * bucket_bytes, bucket_bytes, aad, sizeof(aad), seals[b]);
+
+        double pair_ns = meanNs([&] {
+            for (int b = 0; b < 2; b++)
+                cipher->open(stored + b * bucket_bytes, plain + b * bucket_bytes, bucket_bytes, aad, sizeof(aad), seals[b]);
+            mergeSplit(combined.data(), Z, 0, engine);
+            for (int b = 0; b < 2; b++)
+                cipher->seal(plain + b * bucket_bytes, stored + b * bucket_bytes, bucket_bytes, aad, sizeof(aad), seals[b]);
+        });
+
+        // Extraction: decrypt one bucket and shuffle it as extractFinalBucket does.
+        CounterRng rng(1, 0);
+        double bucket_ns = meanNs([&] {
+            cipher->open(stored, plain, bucket_bytes, aad, sizeof(aad), seals[0]);
+            shuffleBucket(combined.data(), Z, rng, shuffle);
+        });
+        samples.push_back(Sample{ Z, pair_ns, bucket_ns });
+    }
+    return BucketCostModel(std::move(samples));
+}
+
+const BucketCostModel& BucketCostModel::host(CipherKind cipher, MergeSplitEngine engine, BucketShuffle shuffle) {
+    static std::mutex mutex;
+    static std::map<std::tuple<CipherKind, MergeSplitEngine, BucketShuffle>, BucketCostModel> models;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto key = std::make_tuple(cipher, engine, shuffle);
+    auto it = models.find(key);
+    if (it == models.end())
+        it = models.emplace(key, calibrate(cipher, engine, shuffle)).first;
+    return it->second;
+}
+
+double BucketCostModel::interpolate(int Z, double Sample::*field) const {
+    if (table.size() == 1)
+        return table[0].*field * Z / table[0].Z;
+    // Segment containing Z, or the first/last one when extrapolating.
+    size_t hi = 1;
+    while (hi + 1 < table.size() && table[hi].Z < Z)
+        hi++;
+    const Sample& a = table[hi - 1];
+    const Sample& b = table[hi];
+    double t = std::log(static_cast<double>(Z) / a.Z) / std::log(static_cast<double>(b.Z) / a.Z);
+    return std::exp(std::log(a.*field) + t * (std::log(b.*field) - std::log(a.*field)));
+}
+
+double BucketCostModel::pairNs(int Z) const {
+    return interpolate(Z, &Sample::pair_ns);
+}
+
+double BucketCostModel::bucketNs(int Z) const {
+    return interpolate(Z, &Sample::bucket_ns);
+}
+
+double BucketCostModel::predictMs(int B, int L, int Z) const {
+    return (static_cast<double>(L) * (B / 2) * pairNs(Z) + static_cast<double>(B) * bucketNs(Z)) / 1e6;
+}
+
+// ----- Parameter Choice -----
+BucketParameters chooseBucketParameters(int n, double target_failure, const BucketCostModel& model, int max_Z) {
+    BucketParameters best;
+    // More buckets than 2n only adds padding: every bucket would start nearly empty.
+    for (int L = 0; L < 31; L++) {
+        int B = 1 << L;
+        if (L > 0 && B > 2 * static_cast<long long>(n))
+            break;
+        // The failure bound falls as Z grows: binary search for the smallest Z meeting it.
+        int lo = std::max(2, static_cast<int>((static_cast<long long>(n) + B - 1) / B));
+        int hi = max_Z;
+        if (lo > hi || overflowProbability(n, B, hi) > target_failure)
+            continue;
+        while (lo < hi) {
+            int mid = lo + (hi - lo) / 2;
+            if (overflowProbability(n, B, mid) <= target_failure)
+                hi = mid;
+            else
+                lo = mid + 1;
+        }
+        double ms = model.predictMs(B, L, lo);
+        if (best.B == 0 || ms < best.predicted_ms)
+            best = BucketParameters{ lo, B, L, overflowProbability(n, B, lo), ms };
+    }
+    if (best.B == 0)
+        throw std::invalid_argument("No bucket size up to max_Z meets the failure target.");
+    return best;
+}
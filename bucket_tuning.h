@@ -0,0 +1,77 @@
+#ifndef BUCKET_TUNING_H
+#define BUCKET_TUNING_H
+
+#include <vector>
+#include <cstddef>
+#include "bucket_cipher.h"
+#include "merge_split.h"
+#include "bucket_shuffle.h"
+
+// Choice of the bucket parameters of the oblivious bucket sort: the bucket size Z, the
+// bucket count B = 2^L, and what they cost.
+//
+// The butterfly routes on key bits, so B stays a power of two; the padding is trimmed on
+// the other axis instead. Z may be any size, and is chosen as the smallest one whose
+// overflow probability meets the target for each candidate B, rather than B being
+// rounded up for a fixed Z.
+
+struct BucketParameters {
+    int Z = 0;
+    int B = 0;
+    int L = 0;
+    // Union bound on the probability that some MergeSplit overflows (see
+    // overflowProbability); the sort then throws std::overflow_error.
+    double failure_probability = 0;
+    // Network and extraction time predicted by the cost model, or 0 if none was used.
+    double predicted_ms = 0;
+
+    size_t paddedSlots() const { return static_cast<size_t>(B) * Z; }
+};
+
+// Upper bound on the probability that a sort of n elements with B buckets of Z slots
+// overflows. Level 0 holds ceil(n / B) elements per bucket; a bucket of level i gathers
+// the elements of 2^i level-0 buckets whose keys agree on i bits, a Binomial(min(n,
+// 2^i * ceil(n / B)), 2^-i) count. The bound is the sum over every bucket of every level
+// of its exact binomial tail above Z.
+double overflowProbability(int n, int B, int Z);
+
+// Host-specific cost of the two bucket-sized steps of the sort, measured once by
+// timing them at power-of-two bucket sizes and interpolated in between on a log-log
+// scale.
+class BucketCostModel {
+public:
+    struct Sample {
+        int Z;
+        double pair_ns;    // One MergeSplit, including decrypting and re-encrypting both buckets.
+        double bucket_ns;  // Extracting one final bucket: decrypt and oblivious permutation.
+    };
+
+    explicit BucketCostModel(std::vector<Sample> samples);
+
+    // Times the steps with this cipher, MergeSplit engine and bucket shuffle on the calling
+    // thread (tens of ms).
+    static BucketCostModel calibrate(CipherKind cipher, MergeSplitEngine engine, BucketShuffle shuffle);
+
+    // calibrate() for this host, run once per (cipher, engine, shuffle) and then cached.
+    static const BucketCostModel& host(CipherKind cipher, MergeSplitEngine engine, BucketShuffle shuffle);
+
+    double pairNs(int Z) const;
+    double bucketNs(int Z) const;
+
+    // Single-threaded time of the butterfly network and the extraction.
+    double predictMs(int B, int L, int Z) const;
+
+    const std::vector<Sample>& samples() const { return table; }
+
+private:
+    double interpolate(int Z, double Sample::*field) const;
+
+    std::vector<Sample> table;
+};
+
+// Picks the cheapest (Z, B) under the model among those whose overflowProbability is at
+// most target_failure, with Z <= max_Z. Throws std::invalid_argument if there is none.
+BucketParameters chooseBucketParameters(int n, double target_failure, const BucketCostModel& model,
+                                        int max_Z = 1 << 14);
+
+#endif // BUCKET_TUNING_H
@@ -0,0 +1,412 @@
+#include "bulk_loader.h"
+#include <stdexcept>
+#include <fstream>
+#include <cstring>
+#include <cerrno>
+#include <limits>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static const char kIntMagic[4] = { 'O', 'S', 'I', '1' };
+static const char kStringMagic[4] = { 'O', 'S', 'S', '1' };
+static const size_t kHeaderBytes = 16;
+
+// ----- MappedFile Methods -----
+MappedFile::MappedFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Could not open " + path + ": " + std::strerror(errno));
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error("Could not stat " + path);
+    }
+    length = static_cast<size_t>(st.st_size);
+    if (length > 0) {
+        void* addr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Could not map " + path);
+        }
+        madvise(addr, length, MADV_SEQUENTIAL);
+        base = static_cast<const char*>(addr);
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (base)
+        munmap(const_cast<char*>(base), length);
+}
+
+// ----- Format Detection -----
+static bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+ArrayFormat detectFormat(const char* data, size_t size) {
+    if (size >= kHeaderBytes && (std::memcmp(data, kIntMagic, 4) == 0 || std::memcmp(data, kStringMagic, 4) == 0))
+        return ArrayFormat::Binary;
+    for (size_t i = 0; i < size; i++)
+        if (!isBlank(data[i]))
+            return data[i] == '[' ? ArrayFormat::Json : ArrayFormat::Lines;
+    return ArrayFormat::Lines;
+}
+
+ArrayFormat formatForPath(const std::string& path) {
+    return path.size() >= 4 && path.compare(path.size() - 4, 4, ".bin") == 0 ? ArrayFormat::Binary : ArrayFormat::Lines;
+}
+
+static uint64_t readHeaderCount(const char* data, size_t size, const char magic[4]) {
+    if (size < kHeaderBytes || std::memcmp(data, magic, 4) != 0)
+        throw std::invalid_argument("Binary input has the wrong type or a truncated header.");
+    uint64_t count;
+    std::memcpy(&count, data + 8, sizeof(count));
+    return count;
+}
+
+// ----- Integer Parsing -----
+// Converts 8 ASCII digits (first digit in the lowest byte) with three multiplications,
+// combining neighbouring digits, then pairs, then quads.
+static inline uint32_t parseEightDigits(uint64_t chunk) {
+    chunk -= 0x3030303030303030ull;
+    chunk = (chunk * 10) + (chunk >> 8);
+    chunk = (((chunk & 0x000000FF000000FFull) * (100 + (1000000ull << 32))) +
+             (((chunk >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32)))) >> 32;
+    return static_cast<uint32_t>(chunk);
+}
+
+// Value of the len <= 8 digits at p; p must have 8 readable bytes.
+static inline uint32_t parseShortDigits(const char* p, size_t len) {
+    uint64_t chunk;
+    std::memcpy(&chunk, p, 8);
+    if (len < 8) {
+        // Drop the bytes past the number and pad with leading '0' digits.
+        size_t shift = 8 * (8 - len);
+        chunk = (chunk << shift) | (0x3030303030303030ull >> (64 - shift));
+    }
+    return parseEightDigits(chunk);
+}
+
+// Number of consecutive digits at p, looking at 16 bytes at once. p must have 16
+// readable bytes.
+static inline size_t countDigits16(const char* p) {
+#if defined(__SSE2__)
+    __m128i v = _mm_sub_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), _mm_set1_epi8('0'));
+    __m128i digit = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(9)), v);
+    unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(digit));
+    return static_cast<size_t>(__builtin_ctz(~mask | 0x10000u));
+#else
+    size_t n = 0;
+    while (n < 16 && static_cast<unsigned char>(p[n] - '0') < 10)
+        n++;
+    return n;
+#endif
+}
+
+static inline bool isSeparator(char c) {
+    return isBlank(c) || c == ',' || c == '[' || c == ']';
+}
+
+void parseIntText(const char* data, size_t size, std::vector<int32_t>& out) {
+    const char* p = data;
+    const char* end = data + size;
+    while (true) {
+        while (p < end && isSeparator(*p))
+            p++;
+        if (p == end)
+            break;
+        bool negative = *p == '-';
+        if (negative || *p == '+')
+            p++;
+
+        uint64_t value;
+        size_t len;
+        if (end - p >= 16) {
+            len = countDigits16(p);
+            if (len == 0)
+                throw std::invalid_argument("Unexpected character in integer array.");
+            if (len == 16)
+                throw std::out_of_range("Integer out of range in input.");
+            if (len <= 8)
+                value = parseShortDigits(p, len);
+            else
+                value = uint64_t(parseShortDigits(p, len - 8)) * 100000000ull + parseShortDigits(p + len - 8, 8);
+        }
+        else {
+            // Tail of the buffer: fewer than 16 readable bytes.
+            value = 0;
+            len = 0;
+            while (p + len < end && static_cast<unsigned char>(p[len] - '0') < 10) {
+                value = value * 10 + static_cast<unsigned>(p[len] - '0');
+                if (++len > 15)
+                    throw std::out_of_range("Integer out of range in input.");
+            }
+            if (len == 0)
+                throw std::invalid_argument("Unexpected character in integer array.");
+        }
+        p += len;
+        if (p < end && !isSeparator(*p))
+            throw std::invalid_argument("Unexpected character in integer array.");
+
+        int64_t signed_value = negative ? -static_cast<int64_t>(value) : static_cast<int64_t>(value);
+        if (signed_value < std::numeric_limits<int32_t>::min() || signed_value > std::numeric_limits<int32_t>::max())
+            throw std::out_of_range("Integer out of range in input.");
+        out.push_back(static_cast<int32_t>(signed_value));
+    }
+}
+
+std::vector<int32_t> loadIntArray(const std::string& path) {
+    MappedFile file(path);
+    std::vector<int32_t> values;
+    if (detectFormat(file.data(), file.size()) == ArrayFormat::Binary) {
+        uint64_t count = readHeaderCount(file.data(), file.size(), kIntMagic);
+        if (count > (file.size() - kHeaderBytes) / sizeof(int32_t))
+            throw std::invalid_argument("Binary integer input is truncated.");
+        values.resize(count);
+        std::memcpy(values.data(), file.data() + kHeaderBytes, count * sizeof(int32_t));
+        return values;
+    }
+    // A number takes at least two bytes with its separator; reserving for that avoids
+    // regrowth without scanning the input twice.
+    values.reserve(file.size() / 2 + 1);
+    parseIntText(file.data(), file.size(), values);
+    values.shrink_to_fit();
+    return values;
+}
+
+// ----- String Splitting -----
+static std::string_view trimmed(const char* begin, const char* end) {
+    while (begin < end && isBlank(*begin))
+        begin++;
+    while (end > begin && isBlank(end[-1]))
+        end--;
+    if (end - begin >= 2 && *begin == '"' && end[-1] == '"') {
+        begin++;
+        end--;
+    }
+    return std::string_view(begin, static_cast<size_t>(end - begin));
+}
+
+// Splits [begin, end) at every `separator` with memchr, which scans a vector at a time.
+static void splitAt(const char* begin, const char* end, char separator, std::vector<std::string_view>& out) {
+    const char* p = begin;
+    while (p <= end) {
+        const char* next = static_cast<const char*>(std::memchr(p, separator, static_cast<size_t>(end - p)));
+        const char* stop = next ? next : end;
+        out.emplace_back(p, static_cast<size_t>(stop - p));
+        if (!next)
+            break;
+        p = next + 1;
+    }
+}
+
+// Splits the items of a Json string array. A quoted item runs to its closing quote, so
+// it may hold commas; unquoted items end at the next comma.
+static void splitJsonItems(const char* begin, const char* end, std::vector<std::string_view>& out) {
+    const char* p = begin;
+    while (true) {
+        while (p < end && isBlank(*p))
+            p++;
+        const char* next;
+        if (p < end && *p == '"') {
+            const char* close = std::find(p + 1, end, '"');
+            if (close == end)
+                throw std::invalid_argument("Json string input has an unterminated quote.");
+            out.emplace_back(p + 1, static_cast<size_t>(close - p - 1));
+            next = close + 1;
+            while (next < end && isBlank(*next))
+                next++;
+            if (next < end && *next != ',')
+                throw std::invalid_argument("Json string input has text after a closing quote.");
+        }
+        else {
+            next = std::find(p, end, ',');
+            out.push_back(trimmed(p, next));
+        }
+        if (next == end)
+            break;
+        p = next + 1;
+    }
+}
+
+StringArray StringArray::load(const std::string& path) {
+    StringArray array;
+    array.file = std::make_shared<MappedFile>(path);
+    const char* data = array.file->data();
+    size_t size = array.file->size();
+
+    switch (detectFormat(data, size)) {
+    case ArrayFormat::Binary: {
+        uint64_t count = readHeaderCount(data, size, kStringMagic);
+        size_t table = kHeaderBytes + (count + 1) * sizeof(uint64_t);
+        if (count > size / sizeof(uint64_t) || table > size)
+            throw std::invalid_argument("Binary string input is truncated.");
+        const char* bytes = data + table;
+        size_t byte_count = size - table;
+        array.items.reserve(count);
+        uint64_t begin;
+        std::memcpy(&begin, data + kHeaderBytes, sizeof(begin));
+        for (uint64_t i = 0; i < count; i++) {
+            uint64_t end;
+            std::memcpy(&end, data + kHeaderBytes + (i + 1) * sizeof(uint64_t), sizeof(end));
+            if (end < begin || end > byte_count)
+                throw std::invalid_argument("Binary string input has a bad offset table.");
+            array.items.emplace_back(bytes + begin, end - begin);
+            begin = end;
+        }
+        break;
+    }
+    case ArrayFormat::Json: {
+        const char* begin = static_cast<const char*>(std::memchr(data, '[', size)) + 1;
+        const char* end = data + size;
+        while (end > begin && isBlank(end[-1]))
+            end--;
+        if (end > begin && end[-1] == ']')
+            end--;
+        const char* first = begin;
+        while (first < end && isBlank(*first))
+            first++;
+        if (first == end)
+            break;  // "[]"
+        splitJsonItems(begin, end, array.items);
+        break;
+    }
+    case ArrayFormat::Lines: {
+        if (size == 0)
+            break;
+        const char* end = data + size;
+        if (end[-1] == '\n')
+            end--;  // No empty value after the final newline.
+        splitAt(data, end, '\n', array.items);
+        for (auto& item : array.items)
+            if (!item.empty() && item.back() == '\r')
+                item.remove_suffix(1);
+        break;
+    }
+    }
+    return array;
+}
+
+std::vector<std::string> StringArray::toStrings() const {
+    return std::vector<std::string>(items.begin(), items.end());
+}
+
+// ----- Writers -----
+namespace {
+
+// Output file with a large stream buffer.
+struct OutputFile {
+    std::vector<char> buffer;  // Declared first: the stream flushes into it on destruction.
+    std::ofstream out;
+
+    explicit OutputFile(const std::string& path) : buffer(1 << 20) {
+        out.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+        out.open(path, std::ios::binary);
+        if (!out)
+            throw std::runtime_error("Could not open " + path + " for writing");
+    }
+
+    void header(const char magic[4], uint64_t count) {
+        char head[kHeaderBytes] = {};
+        std::memcpy(head, magic, 4);
+        std::memcpy(head + 8, &count, sizeof(count));
+        out.write(head, sizeof(head));
+    }
+
+    void finish() {
+        out.flush();
+        if (!out)
+            throw std::runtime_error("Write error on output file.");
+    }
+};
+
+template <class Strings>
+void writeStrings(const std::string& path, const Strings& values, ArrayFormat format) {
+    OutputFile file(path);
+    if (format == ArrayFormat::Binary) {
+        file.header(kStringMagic, values.size());
+        uint64_t offset = 0;
+        file.out.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+        for (const auto& v : values) {
+            offset += v.size();
+            file.out.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+        }
+        for (const auto& v : values)
+            file.out.write(v.data(), v.size());
+    }
+    else if (format == ArrayFormat::Json) {
+        file.out.put('[');
+        for (size_t i = 0; i < values.size(); i++) {
+            if (i > 0)
+                file.out.put(',');
+            std::string_view value = values[i];
+            bool quote = value.find(',') != std::string_view::npos;
+            if (quote && value.find('"') != std::string_view::npos)
+                throw std::invalid_argument("Json output cannot hold a value with both a comma and a quote.");
+            if (quote)
+                file.out.put('"');
+            file.out.write(value.data(), value.size());
+            if (quote)
+                file.out.put('"');
+        }
+        file.out.put(']');
+    }
+    else {
+        for (const auto& v : values) {
+            file.out.write(v.data(), v.size());
+            file.out.put('\n');
+        }
+    }
+    file.finish();
+}
+
+} // namespace
+
+void writeIntArray(const std::string& path, const std::vector<int32_t>& values, ArrayFormat format) {
+    OutputFile file(path);
+    if (format == ArrayFormat::Binary) {
+        file.header(kIntMagic, values.size());
+        file.out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(int32_t));
+    }
+    else {
+        bool json = format == ArrayFormat::Json;
+        if (json)
+            file.out.put('[');
+        char digits[16];
+        for (size_t i = 0; i < values.size(); i++) {
+            if (json && i > 0)
+                file.out.put(',');
+            // Digits are produced back to front into a small buffer.
+            int64_t v = values[i];
+            uint64_t magnitude = v < 0 ? static_cast<uint64_t>(-v) : static_cast<uint64_t>(v);
+            char* p = digits + sizeof(digits);
+            do {
+                *--p = static_cast<char>('0' + magnitude % 10);
+                magnitude /= 10;
+            } while (magnitude > 0);
+            if (v < 0)
+                *--p = '-';
+            file.out.write(p, digits + sizeof(digits) - p);
+            if (!json)
+                file.out.put('\n');
+        }
+        if (json)
+            file.out.put(']');
+    }
+    file.finish();
+}
+
+void writeStringArray(const std::string& path, const std::vector<std::string_view>& values, ArrayFormat format) {
+    writeStrings(path, values, format);
+}
+
+void writeStringArray(const std::string& path, const std::vector<std::string>& values, ArrayFormat format) {
+    writeStrings(path, values, format);
+}
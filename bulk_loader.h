@@ -0,0 +1,80 @@
+#ifndef BULK_LOADER_H
+#define BULK_LOADER_H
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+// Bulk loaders for the sort inputs. Files are memory-mapped and parsed in place: integer
+// arrays go through a vectorized number parser, and string arrays are split into
+// string_views into the mapping, with no allocation per element.
+//
+// Three layouts are recognized when loading:
+//   Json    "[1, -2, 3]" or "[abc,"de",f]": the array inputs the drivers have always read
+//           (quotes around strings are optional, but a string with a comma must be
+//           quoted; no escape sequences). The writer quotes strings with commas.
+//   Lines   one value per line: the drivers' output format.
+//   Binary  compact little-endian format with a 16-byte header, see below.
+//
+// Binary layout: 4-byte magic, 4 reserved bytes, uint64 count, then
+//   ints    ("OSI1"): count int32 values;
+//   strings ("OSS1"): count + 1 uint64 byte offsets, then the concatenated bytes.
+enum class ArrayFormat { Json, Lines, Binary };
+
+// Read-only mapping of a whole file.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return base; }
+    size_t size() const { return length; }
+
+private:
+    const char* base = nullptr;
+    size_t length = 0;
+};
+
+// Layout of the bytes: Binary if they start with a known magic, Json if the first
+// non-blank character is '[', Lines otherwise.
+ArrayFormat detectFormat(const char* data, size_t size);
+
+// Binary for a ".bin" path, Lines otherwise.
+ArrayFormat formatForPath(const std::string& path);
+
+// Parses every integer in the file. Throws std::invalid_argument on malformed input
+// and std::out_of_range on values that do not fit in 32 bits.
+std::vector<int32_t> loadIntArray(const std::string& path);
+
+// Parses integers from a text buffer (Json or Lines). Exposed for the benchmarks.
+void parseIntText(const char* data, size_t size, std::vector<int32_t>& out);
+
+// Strings of a loaded array. The views point into the mapped file, which the array
+// keeps alive; copying the array shares the mapping.
+class StringArray {
+public:
+    static StringArray load(const std::string& path);
+
+    const std::vector<std::string_view>& values() const { return items; }
+    size_t size() const { return items.size(); }
+    std::string_view operator[](size_t i) const { return items[i]; }
+
+    // Copies the values into owning strings.
+    std::vector<std::string> toStrings() const;
+
+private:
+    std::shared_ptr<MappedFile> file;
+    std::vector<std::string_view> items;
+};
+
+void writeIntArray(const std::string& path, const std::vector<int32_t>& values, ArrayFormat format);
+void writeStringArray(const std::string& path, const std::vector<std::string_view>& values, ArrayFormat format);
+void writeStringArray(const std::string& path, const std::vector<std::string>& values, ArrayFormat format);
+
+#endif // BULK_LOADER_H
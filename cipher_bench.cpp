@@ -0,0 +1,66 @@
+// cipher_bench.cpp (Benchmark: bucket cipher throughput and crypto cost per butterfly level)
+// Usage: cipher_bench [n = 1000000] [bucket_size = 256]
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstring>
+#include "oblivious_sort.h"
+#include "bucket_cipher.h"
+
+// Seals then opens one bucket-sized buffer in place, repeatedly, and returns GB/s over
+// the bytes processed by both directions.
+static double measureThroughput(BucketCipher& cipher, size_t bytes) {
+    std::vector<uint8_t> buffer(bytes, 0x5a);
+    uint8_t aad[8] = {};
+    BucketSeal seal;
+    size_t rounds = std::max<size_t>(1, (size_t(256) << 20) / bytes);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < rounds; r++) {
+        std::memcpy(aad, &r, sizeof(uint32_t));
+        cipher.seal(buffer.data(), buffer.data(), bytes, aad, sizeof(aad), seal);
+        cipher.open(buffer.data(), buffer.data(), bytes, aad, sizeof(aad), seal);
+    }
+    auto stop = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(stop - start).count();
+    return (2.0 * rounds * bytes) / seconds / 1e9;
+}
+
+int main(int argc, char** argv) {
+    int n = argc > 1 ? std::stoi(argv[1]) : 1000000;
+    int Z = argc > 2 ? std::stoi(argv[2]) : 256;
+
+    std::vector<CipherKind> kinds = { CipherKind::Xor };
+    if (AesGcmCipher::supported())
+        kinds.push_back(CipherKind::AesGcm);
+    else
+        std::cout << "# AES-NI not available; skipping aes-128-gcm\n";
+
+    std::cout << "cipher,bucket_slots,bucket_bytes,gb_per_s\n";
+    for (CipherKind kind : kinds) {
+        auto cipher = makeBucketCipher(kind);
+        for (int slots = 64; slots <= 4096; slots *= 2) {
+            size_t bytes = slots * sizeof(ElementTag);
+            std::cout << cipher->name() << "," << slots << "," << bytes << ","
+                      << std::fixed << std::setprecision(3) << measureThroughput(*cipher, bytes) << "\n";
+        }
+    }
+
+    // Each butterfly level opens and reseals every bucket once.
+    FlatUntrustedMemory untrusted;
+    Enclave enclave(&untrusted);
+    auto [B, L] = enclave.computeBucketParameters(n, Z);
+    size_t level_bytes = 2 * static_cast<size_t>(B) * Z * sizeof(ElementTag);
+    std::cout << "\n# n = " << n << ", Z = " << Z << ", B = " << B << ", L = " << L
+              << ", bytes through the cipher per level = " << level_bytes << "\n";
+    std::cout << "cipher,ms_per_level,ms_per_sort\n";
+    for (CipherKind kind : kinds) {
+        auto cipher = makeBucketCipher(kind);
+        double gbps = measureThroughput(*cipher, Z * sizeof(ElementTag));
+        double ms_level = level_bytes / (gbps * 1e9) * 1e3;
+        std::cout << cipher->name() << "," << std::fixed << std::setprecision(3)
+                  << ms_level << "," << ms_level * (L + 1) << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,472 @@
+#include "compare_exchange.h"
+#include "bitonic_network.h"
+#include <atomic>
+#include <cstring>
+#include <utility>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CMPEX_X86 1
+#else
+#define CMPEX_X86 0
+#endif
+
+// The wide vector helpers are only ever inlined into the target-specific entry points;
+// their out-of-line copies would use a different ABI, which GCC warns about.
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+namespace cmpex {
+namespace {
+
+// Branchless scalar compare-exchange: the pair is always rewritten, and the
+// selection is done with a mask rather than a branch.
+template <class T>
+inline void exchangeScalar(T* p, size_t i, size_t j, bool ascending) {
+    T x = p[i];
+    T y = p[j];
+    T mask = T(0) - T(y < x);
+    T d = (x ^ y) & mask;
+    T lo = x ^ d;
+    T hi = y ^ d;
+    p[i] = ascending ? lo : hi;
+    p[j] = ascending ? hi : lo;
+}
+
+// As exchangeScalar, with the value words v following their keys through the same mask.
+template <class T>
+inline void exchangeScalarKV(T* p, T* v, size_t i, size_t j, bool ascending) {
+    T x = p[i];
+    T y = p[j];
+    T mask = T(0) - T(y < x);
+    T d = (x ^ y) & mask;
+    T vd = (v[i] ^ v[j]) & mask;
+    T vx = v[i] ^ vd;
+    T vy = v[j] ^ vd;
+    p[i] = ascending ? x ^ d : y ^ d;
+    p[j] = ascending ? y ^ d : x ^ d;
+    v[i] = ascending ? vx : vy;
+    v[j] = ascending ? vy : vx;
+}
+
+// Vector operations on W lanes of T, written with compiler vector extensions so that
+// one definition serves every ISA: the same code is compiled to ymm/zmm instructions
+// inside the target-specific entry points below, and to plain scalar code for W == 1.
+template <class T, size_t W>
+struct VecOps {
+    using value_type = T;
+    typedef T vec __attribute__((vector_size(W * sizeof(T))));
+    static constexpr size_t width = W;
+
+    static vec load(const T* p) { vec v; std::memcpy(&v, p, sizeof(vec)); return v; }
+    static void store(T* p, vec v) { std::memcpy(p, &v, sizeof(vec)); }
+    static vec min(vec a, vec b) { return a < b ? a : b; }
+    static vec max(vec a, vec b) { return a < b ? b : a; }
+
+    template <size_t... I>
+    static vec reverseLanes(vec v, std::index_sequence<I...>) {
+        return __builtin_shufflevector(v, v, (W - 1 - I)...);
+    }
+    static vec reverse(vec v) { return reverseLanes(v, std::make_index_sequence<W>()); }
+};
+
+// Network kernel built on a vector-ops class V (V::width lanes of V::value_type).
+// Runs shorter than one vector, and the remainder of longer runs, use the scalar path.
+template <class V>
+struct VectorKernel {
+    typename V::value_type* p;
+    bool ascending;
+
+    void forward(size_t i, size_t j, size_t len) {
+        size_t t = 0;
+        for (; t + V::width <= len; t += V::width) {
+            auto a = V::load(p + i + t);
+            auto b = V::load(p + j + t);
+            auto lo = V::min(a, b);
+            auto hi = V::max(a, b);
+            V::store(p + i + t, ascending ? lo : hi);
+            V::store(p + j + t, ascending ? hi : lo);
+        }
+        for (; t < len; t++)
+            exchangeScalar(p, i + t, j + t, ascending);
+    }
+
+    void mirrored(size_t i, size_t j, size_t len) {
+        size_t t = 0;
+        for (; t + V::width <= len; t += V::width) {
+            // Partners of lanes i+t .. i+t+W-1 are j-t .. j-t-W+1: load them reversed.
+            auto a = V::load(p + i + t);
+            auto b = V::reverse(V::load(p + j - t - (V::width - 1)));
+            auto lo = V::min(a, b);
+            auto hi = V::max(a, b);
+            V::store(p + i + t, ascending ? lo : hi);
+            V::store(p + j - t - (V::width - 1), V::reverse(ascending ? hi : lo));
+        }
+        for (; t < len; t++)
+            exchangeScalar(p, i + t, j - t, ascending);
+    }
+};
+
+// VectorKernel over (key, value) words: the lane mask of each key comparison selects the
+// values too, so the values are permuted exactly as the keys.
+template <class V>
+struct KeyValueKernel {
+    typename V::value_type* p;
+    typename V::value_type* v;
+    bool ascending;
+
+    void forward(size_t i, size_t j, size_t len) {
+        size_t t = 0;
+        for (; t + V::width <= len; t += V::width) {
+            auto a = V::load(p + i + t);
+            auto b = V::load(p + j + t);
+            auto va = V::load(v + i + t);
+            auto vb = V::load(v + j + t);
+            auto swap = b < a;
+            auto lo = swap ? b : a;
+            auto hi = swap ? a : b;
+            auto vlo = swap ? vb : va;
+            auto vhi = swap ? va : vb;
+            V::store(p + i + t, ascending ? lo : hi);
+            V::store(p + j + t, ascending ? hi : lo);
+            V::store(v + i + t, ascending ? vlo : vhi);
+            V::store(v + j + t, ascending ? vhi : vlo);
+        }
+        for (; t < len; t++)
+            exchangeScalarKV(p, v, i + t, j + t, ascending);
+    }
+
+    void mirrored(size_t i, size_t j, size_t len) {
+        size_t t = 0;
+        for (; t + V::width <= len; t += V::width) {
+            size_t back = j - t - (V::width - 1);
+            auto a = V::load(p + i + t);
+            auto b = V::reverse(V::load(p + back));
+            auto va = V::load(v + i + t);
+            auto vb = V::reverse(V::load(v + back));
+            auto swap = b < a;
+            auto lo = swap ? b : a;
+            auto hi = swap ? a : b;
+            auto vlo = swap ? vb : va;
+            auto vhi = swap ? va : vb;
+            V::store(p + i + t, ascending ? lo : hi);
+            V::store(p + back, V::reverse(ascending ? hi : lo));
+            V::store(v + i + t, ascending ? vlo : vhi);
+            V::store(v + back, V::reverse(ascending ? vhi : vlo));
+        }
+        for (; t < len; t++)
+            exchangeScalarKV(p, v, i + t, j - t, ascending);
+    }
+};
+
+// Sorts of 8 to 64 elements run the unrolled network from bitonic::FixedNetwork: every
+// compare-exchange is a pair of constant offsets, with nothing else around it. The swap
+// is masked as in exchangeScalar: plain selects are turned into branches once the whole
+// network is straight-line code.
+template <size_t N, bool Ascending, class T>
+void sortFixed(T* p) {
+    bitonic::FixedNetwork<N>::run([p](auto i, auto j) {
+        T x = p[i];
+        T y = p[j];
+        T d = (x ^ y) & (T(0) - T(Ascending ? y < x : x < y));
+        p[i] = x ^ d;
+        p[j] = y ^ d;
+    });
+}
+
+template <class T>
+bool sortSmall(T* data, size_t n, bool ascending) {
+    switch (n) {
+    case 8: ascending ? sortFixed<8, true>(data) : sortFixed<8, false>(data); return true;
+    case 16: ascending ? sortFixed<16, true>(data) : sortFixed<16, false>(data); return true;
+    case 32: ascending ? sortFixed<32, true>(data) : sortFixed<32, false>(data); return true;
+    case 64: ascending ? sortFixed<64, true>(data) : sortFixed<64, false>(data); return true;
+    default: return false;
+    }
+}
+
+// The key/value form: the mask that orders the keys swaps the values too. Sorts and
+// merges of (key, value) words of these sizes, as in MergeSplit and the bucket shuffle
+// with small buckets, run here.
+template <bool Ascending>
+struct FixedKV {
+    uint64_t* p;
+    uint64_t* v;
+
+    template <class I, class J>
+    void operator()(I i, J j) const {
+        uint64_t x = p[i], y = p[j];
+        uint64_t mask = uint64_t(0) - uint64_t(Ascending ? y < x : x < y);
+        uint64_t d = (x ^ y) & mask;
+        uint64_t vd = (v[i] ^ v[j]) & mask;
+        p[i] = x ^ d;
+        p[j] = y ^ d;
+        v[i] ^= vd;
+        v[j] ^= vd;
+    }
+};
+
+template <size_t N, bool Ascending>
+void sortFixedKV(uint64_t* keys, uint64_t* values) {
+    bitonic::FixedNetwork<N>::run(FixedKV<Ascending>{ keys, values });
+}
+
+template <size_t N, bool Ascending>
+void mergeFixedKV(uint64_t* keys, uint64_t* values) {
+    bitonic::FixedNetwork<N>::runMerge(FixedKV<Ascending>{ keys, values });
+}
+
+bool sortSmallKV(uint64_t* keys, uint64_t* values, size_t n, bool ascending) {
+    switch (n) {
+    case 8: ascending ? sortFixedKV<8, true>(keys, values) : sortFixedKV<8, false>(keys, values); return true;
+    case 16: ascending ? sortFixedKV<16, true>(keys, values) : sortFixedKV<16, false>(keys, values); return true;
+    case 32: ascending ? sortFixedKV<32, true>(keys, values) : sortFixedKV<32, false>(keys, values); return true;
+    case 64: ascending ? sortFixedKV<64, true>(keys, values) : sortFixedKV<64, false>(keys, values); return true;
+    default: return false;
+    }
+}
+
+bool mergeSmallKV(uint64_t* keys, uint64_t* values, size_t n, bool ascending) {
+    switch (n) {
+    case 8: ascending ? mergeFixedKV<8, true>(keys, values) : mergeFixedKV<8, false>(keys, values); return true;
+    case 16: ascending ? mergeFixedKV<16, true>(keys, values) : mergeFixedKV<16, false>(keys, values); return true;
+    case 32: ascending ? mergeFixedKV<32, true>(keys, values) : mergeFixedKV<32, false>(keys, values); return true;
+    case 64: ascending ? mergeFixedKV<64, true>(keys, values) : mergeFixedKV<64, false>(keys, values); return true;
+    default: return false;
+    }
+}
+
+template <class V>
+void runSort(typename V::value_type* data, size_t n, bool ascending) {
+    VectorKernel<V> kernel{ data, ascending };
+    bitonic::sortNetwork(n, kernel, bitonic::defaultTile<typename V::value_type>());
+}
+
+template <class V>
+void runSelect(typename V::value_type* data, size_t n, size_t k, bool ascending) {
+    VectorKernel<V> kernel{ data, ascending };
+    bitonic::selectNetwork(n, k, kernel, bitonic::defaultTile<typename V::value_type>());
+}
+
+// Keys and values share the cache tile.
+template <class V>
+void runSortKV(typename V::value_type* keys, typename V::value_type* values, size_t n, bool ascending) {
+    KeyValueKernel<V> kernel{ keys, values, ascending };
+    bitonic::sortNetwork(n, kernel, bitonic::defaultTile<typename V::value_type>() / 2);
+}
+
+template <class V>
+void runMergeKV(typename V::value_type* keys, typename V::value_type* values, size_t n, bool ascending) {
+    KeyValueKernel<V> kernel{ keys, values, ascending };
+    bitonic::mergeNetwork(n, kernel, bitonic::defaultTile<typename V::value_type>() / 2);
+}
+
+template <class V>
+void runSelectKV(typename V::value_type* keys, typename V::value_type* values, size_t n, size_t k, bool ascending) {
+    KeyValueKernel<V> kernel{ keys, values, ascending };
+    bitonic::selectNetwork(n, k, kernel, bitonic::defaultTile<typename V::value_type>() / 2);
+}
+
+#if CMPEX_X86
+
+// One flattened entry point per ISA: the network and kernel are inlined into it and
+// compiled for that target, while the rest of the binary stays baseline x86-64.
+__attribute__((target("avx2"), flatten))
+void sortInt32Avx2(int32_t* data, size_t n, bool ascending) {
+    runSort<VecOps<int32_t, 8>>(data, n, ascending);
+}
+
+__attribute__((target("avx2"), flatten))
+void sortUInt64Avx2(uint64_t* data, size_t n, bool ascending) {
+    runSort<VecOps<uint64_t, 4>>(data, n, ascending);
+}
+
+__attribute__((target("avx2"), flatten))
+void selectUInt64Avx2(uint64_t* data, size_t n, size_t k, bool ascending) {
+    runSelect<VecOps<uint64_t, 4>>(data, n, k, ascending);
+}
+
+__attribute__((target("avx2"), flatten))
+void sortKeyValueAvx2(uint64_t* keys, uint64_t* values, size_t n, bool ascending) {
+    runSortKV<VecOps<uint64_t, 4>>(keys, values, n, ascending);
+}
+
+__attribute__((target("avx2"), flatten))
+void mergeKeyValueAvx2(uint64_t* keys, uint64_t* values, size_t n, bool ascending) {
+    runMergeKV<VecOps<uint64_t, 4>>(keys, values, n, ascending);
+}
+
+__attribute__((target("avx2"), flatten))
+void selectKeyValueAvx2(uint64_t* keys, uint64_t* values, size_t n, size_t k, bool ascending) {
+    runSelectKV<VecOps<uint64_t, 4>>(keys, values, n, k, ascending);
+}
+
+__attribute__((target("avx512f"), flatten))
+void sortInt32Avx512(int32_t* data, size_t n, bool ascending) {
+    runSort<VecOps<int32_t, 16>>(data, n, ascending);
+}
+
+__attribute__((target("avx512f"), flatten))
+void sortUInt64Avx512(uint64_t* data, size_t n, bool ascending) {
+    runSort<VecOps<uint64_t, 8>>(data, n, ascending);
+}
+
+__attribute__((target("avx512f"), flatten))
+void selectUInt64Avx512(uint64_t* data, size_t n, size_t k, bool ascending) {
+    runSelect<VecOps<uint64_t, 8>>(data, n, k, ascending);
+}
+
+__attribute__((target("avx512f"), flatten))
+void sortKeyValueAvx512(uint64_t* keys, uint64_t* values, size_t n, bool ascending) {
+    runSortKV<VecOps<uint64_t, 8>>(keys, values, n, ascending);
+}
+
+__attribute__((target("avx512f"), flatten))
+void mergeKeyValueAvx512(uint64_t* keys, uint64_t* values, size_t n, bool ascending) {
+    runMergeKV<VecOps<uint64_t, 8>>(keys, values, n, ascending);
+}
+
+__attribute__((target("avx512f"), flatten))
+void selectKeyValueAvx512(uint64_t* keys, uint64_t* values, size_t n, size_t k, bool ascending) {
+    runSelectKV<VecOps<uint64_t, 8>>(keys, values, n, k, ascending);
+}
+
+#endif // CMPEX_X86
+
+SimdLevel computeDetectedLevel() {
+#if CMPEX_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return SimdLevel::AVX512;
+    if (__builtin_cpu_supports("avx2"))
+        return SimdLevel::AVX2;
+#endif
+    return SimdLevel::Scalar;
+}
+
+std::atomic<int> forced_level{ -1 };
+
+} // namespace
+
+SimdLevel detectSimdLevel() {
+    static const SimdLevel detected = computeDetectedLevel();
+    return detected;
+}
+
+SimdLevel activeSimdLevel() {
+    int forced = forced_level.load(std::memory_order_relaxed);
+    return forced < 0 ? detectSimdLevel() : static_cast<SimdLevel>(forced);
+}
+
+void setSimdLevel(SimdLevel level) {
+    if (static_cast<int>(level) > static_cast<int>(detectSimdLevel()))
+        level = detectSimdLevel();
+    forced_level.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+const char* simdLevelName(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::AVX512: return "avx512";
+    case SimdLevel::AVX2: return "avx2";
+    default: return "scalar";
+    }
+}
+
+void sortInt32(int32_t* data, size_t n, bool ascending) {
+    if (sortSmall(data, n, ascending))
+        return;
+    switch (activeSimdLevel()) {
+#if CMPEX_X86
+    case SimdLevel::AVX512: sortInt32Avx512(data, n, ascending); return;
+    case SimdLevel::AVX2: sortInt32Avx2(data, n, ascending); return;
+#endif
+    default: runSort<VecOps<int32_t, 1>>(data, n, ascending); return;
+    }
+}
+
+void sortUInt64(uint64_t* data, size_t n, bool ascending) {
+    if (sortSmall(data, n, ascending))
+        return;
+    switch (activeSimdLevel()) {
+#if CMPEX_X86
+    case SimdLevel::AVX512: sortUInt64Avx512(data, n, ascending); return;
+    case SimdLevel::AVX2: sortUInt64Avx2(data, n, ascending); return;
+#endif
+    default: runSort<VecOps<uint64_t, 1>>(data, n, ascending); return;
+    }
+}
+
+void sortKeyValue(uint64_t* keys, uint64_t* values, size_t n, bool ascending) {
+    if (sortSmallKV(keys, values, n, ascending))
+        return;
+    switch (activeSimdLevel()) {
+#if CMPEX_X86
+    case SimdLevel::AVX512: sortKeyValueAvx512(keys, values, n, ascending); return;
+    case SimdLevel::AVX2: sortKeyValueAvx2(keys, values, n, ascending); return;
+#endif
+    default: runSortKV<VecOps<uint64_t, 1>>(keys, values, n, ascending); return;
+    }
+}
+
+void mergeKeyValue(uint64_t* keys, uint64_t* values, size_t n, bool ascending) {
+    if (mergeSmallKV(keys, values, n, ascending))
+        return;
+    switch (activeSimdLevel()) {
+#if CMPEX_X86
+    case SimdLevel::AVX512: mergeKeyValueAvx512(keys, values, n, ascending); return;
+    case SimdLevel::AVX2: mergeKeyValueAvx2(keys, values, n, ascending); return;
+#endif
+    default: runMergeKV<VecOps<uint64_t, 1>>(keys, values, n, ascending); return;
+    }
+}
+
+void selectUInt64(uint64_t* data, size_t n, size_t k, bool ascending) {
+    switch (activeSimdLevel()) {
+#if CMPEX_X86
+    case SimdLevel::AVX512: selectUInt64Avx512(data, n, k, ascending); return;
+    case SimdLevel::AVX2: selectUInt64Avx2(data, n, k, ascending); return;
+#endif
+    default: runSelect<VecOps<uint64_t, 1>>(data, n, k, ascending); return;
+    }
+}
+
+void selectKeyValue(uint64_t* keys, uint64_t* values, size_t n, size_t k, bool ascending) {
+    switch (activeSimdLevel()) {
+#if CMPEX_X86
+    case SimdLevel::AVX512: selectKeyValueAvx512(keys, values, n, k, ascending); return;
+    case SimdLevel::AVX2: selectKeyValueAvx2(keys, values, n, k, ascending); return;
+#endif
+    default: runSelectKV<VecOps<uint64_t, 1>>(keys, values, n, k, ascending); return;
+    }
+}
+
+void compactWords(uint64_t* words, size_t n) {
+    for (unsigned j = 0; (size_t(1) << j) < n; j++) {
+        size_t step = size_t(1) << j;
+        for (size_t i = step; i < n; i++) {
+            uint64_t w = words[i];
+            uint64_t a = words[i - step];
+            uint64_t move = (w >> 32) & (w >> (33 + j)) & 1;
+            uint64_t d = (a ^ w) & (0 - move);
+            words[i - step] = a ^ d;
+            words[i] = w ^ d;
+        }
+    }
+}
+
+void compactKeyValue(uint64_t* words, uint64_t* values, size_t n) {
+    for (unsigned j = 0; (size_t(1) << j) < n; j++) {
+        size_t step = size_t(1) << j;
+        for (size_t i = step; i < n; i++) {
+            uint64_t w = words[i];
+            uint64_t a = words[i - step];
+            uint64_t mask = 0 - ((w >> 32) & (w >> (33 + j)) & 1);
+            uint64_t d = (a ^ w) & mask;
+            uint64_t vd = (values[i - step] ^ values[i]) & mask;
+            words[i - step] = a ^ d;
+            words[i] = w ^ d;
+            values[i - step] ^= vd;
+            values[i] ^= vd;
+        }
+    }
+}
+
+} // namespace cmpex
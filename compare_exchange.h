@@ -0,0 +1,80 @@
+#ifndef COMPARE_EXCHANGE_H
+#define COMPARE_EXCHANGE_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Branchless compare-exchange kernels for integer keys.
+//
+// Every compare-exchange is computed with min/max (or compare + blend) and written
+// back unconditionally, so neither the branch history nor the store pattern depends
+// on the data. The kernels plug into the network from bitonic_network.h; the vector
+// width is chosen once at runtime from the host CPU (AVX-512, AVX2 or scalar).
+namespace cmpex {
+
+enum class SimdLevel { Scalar, AVX2, AVX512 };
+
+// Best level supported by the host CPU.
+SimdLevel detectSimdLevel();
+
+// Level used by the sort functions below. Defaults to detectSimdLevel().
+SimdLevel activeSimdLevel();
+
+// Overrides the active level (clamped to what the CPU supports). Used by benchmarks.
+void setSimdLevel(SimdLevel level);
+
+const char* simdLevelName(SimdLevel level);
+
+// Obliviously sorts n 32-bit signed integers in place.
+void sortInt32(int32_t* data, size_t n, bool ascending);
+
+// Obliviously sorts n 64-bit unsigned integers in place.
+void sortUInt64(uint64_t* data, size_t n, bool ascending);
+
+// Obliviously sorts n 64-bit keys, each carrying the value word at the same position:
+// every compare-exchange moves the values with the same mask as the keys, so records
+// that fit in (key, value) travel through the network themselves. Equal keys are never
+// exchanged.
+void sortKeyValue(uint64_t* keys, uint64_t* values, size_t n, bool ascending);
+
+// Bitonic merge of a bitonic sequence of power-of-two length n, as sortKeyValue.
+void mergeKeyValue(uint64_t* keys, uint64_t* values, size_t n, bool ascending);
+
+// Oblivious selection (bitonic::selectNetwork): moves the k smallest words (largest if
+// !ascending) to data[0, k), sorted in that order, and leaves the others after them.
+void selectUInt64(uint64_t* data, size_t n, size_t k, bool ascending);
+
+// selectUInt64 with a value word carried beside each key, as sortKeyValue.
+void selectKeyValue(uint64_t* keys, uint64_t* values, size_t n, size_t k, bool ascending);
+
+// Packs a signed 32-bit key and a 32-bit index into one word whose unsigned order
+// is (key, index). Sorting packed words sorts by key and carries the index along.
+inline uint64_t packKeyIndex(int32_t key, uint32_t index) {
+    return (uint64_t(uint32_t(key) ^ 0x80000000u) << 32) | index;
+}
+
+inline uint32_t packedIndex(uint64_t packed) {
+    return static_cast<uint32_t>(packed);
+}
+
+inline int32_t packedKey(uint64_t packed) {
+    return static_cast<int32_t>(static_cast<uint32_t>(packed >> 32) ^ 0x80000000u);
+}
+
+// Tight order-preserving compaction of packed words laid out as
+// distance << 33 | marked << 32 | index: every marked word moves left by its distance,
+// the number of unmarked words before it, so the marked words end up at the front in
+// their original order. Layer j moves every marked word whose remaining distance has
+// bit j set by exactly 2^j; taking the bits from least significant up, no two marked
+// words ever contend for a slot. Each layer is a fixed sequence of conditional swaps
+// (i - 2^j, i), so the access pattern depends only on n. O(n log n).
+void compactWords(uint64_t* words, size_t n);
+
+// compactWords with a value word carried beside each word through the same swaps. The low
+// 32 bits of the words are free for the caller, so a record of up to 96 bits can be
+// compacted whole instead of being gathered by index afterwards.
+void compactKeyValue(uint64_t* words, uint64_t* values, size_t n);
+
+} // namespace cmpex
+
+#endif // COMPARE_EXCHANGE_H
@@ -0,0 +1,136 @@
+#include "counter_rng.h"
+#include "compare_exchange.h"
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PHILOX_X86 1
+#else
+#define PHILOX_X86 0
+#endif
+
+// The wide vector helpers are only ever inlined into the target-specific entry points.
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+namespace philox {
+namespace {
+
+constexpr uint32_t kMul0 = 0xD2511F53u;
+constexpr uint32_t kMul1 = 0xCD9E8D57u;
+constexpr uint32_t kWeyl0 = 0x9E3779B9u;
+constexpr uint32_t kWeyl1 = 0xBB67AE85u;
+
+// One block, scalar.
+inline void scalarBlock(uint64_t seed, uint64_t stream, uint64_t index, uint32_t* out) {
+    uint32_t c0 = static_cast<uint32_t>(index), c1 = static_cast<uint32_t>(index >> 32);
+    uint32_t c2 = static_cast<uint32_t>(stream), c3 = static_cast<uint32_t>(stream >> 32);
+    uint32_t k0 = static_cast<uint32_t>(seed), k1 = static_cast<uint32_t>(seed >> 32);
+    for (int r = 0; r < 10; r++) {
+        uint64_t p0 = static_cast<uint64_t>(kMul0) * c0;
+        uint64_t p1 = static_cast<uint64_t>(kMul1) * c2;
+        c0 = static_cast<uint32_t>(p1 >> 32) ^ c1 ^ k0;
+        c1 = static_cast<uint32_t>(p1);
+        c2 = static_cast<uint32_t>(p0 >> 32) ^ c3 ^ k1;
+        c3 = static_cast<uint32_t>(p0);
+        k0 += kWeyl0;
+        k1 += kWeyl1;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+// W blocks at consecutive indices, one per lane, with compiler vector extensions: the
+// same definition compiles to xmm, ymm or zmm code depending on the entry point.
+template <size_t W>
+struct Lanes {
+    typedef uint32_t vec __attribute__((vector_size(W * 4)));
+    typedef uint64_t wide __attribute__((vector_size(W * 8)));
+};
+
+template <size_t W>
+inline void rounds(uint64_t seed, uint64_t stream, uint64_t index, uint32_t* out) {
+    using vec = typename Lanes<W>::vec;
+    using wide = typename Lanes<W>::wide;
+    vec c0, c1, c2, c3;
+    for (size_t l = 0; l < W; l++) {
+        c0[l] = static_cast<uint32_t>(index + l);
+        c1[l] = static_cast<uint32_t>((index + l) >> 32);
+    }
+    c2 = vec{} + static_cast<uint32_t>(stream);
+    c3 = vec{} + static_cast<uint32_t>(stream >> 32);
+    uint32_t k0 = static_cast<uint32_t>(seed), k1 = static_cast<uint32_t>(seed >> 32);
+    for (int r = 0; r < 10; r++) {
+        wide p0 = __builtin_convertvector(c0, wide) * kMul0;
+        wide p1 = __builtin_convertvector(c2, wide) * kMul1;
+        vec hi0 = __builtin_convertvector(p0 >> 32, vec), lo0 = __builtin_convertvector(p0, vec);
+        vec hi1 = __builtin_convertvector(p1 >> 32, vec), lo1 = __builtin_convertvector(p1, vec);
+        c0 = hi1 ^ c1 ^ k0;
+        c1 = lo1;
+        c2 = hi0 ^ c3 ^ k1;
+        c3 = lo0;
+        k0 += kWeyl0;
+        k1 += kWeyl1;
+    }
+    for (size_t l = 0; l < W; l++) {
+        out[4 * l] = c0[l];
+        out[4 * l + 1] = c1[l];
+        out[4 * l + 2] = c2[l];
+        out[4 * l + 3] = c3[l];
+    }
+}
+
+template <size_t W>
+inline void runBlocks(uint64_t seed, uint64_t stream, uint64_t index, size_t count, uint32_t* out) {
+    size_t b = 0;
+    for (; b + W <= count; b += W)
+        rounds<W>(seed, stream, index + b, out + 4 * b);
+    for (; b < count; b++)
+        scalarBlock(seed, stream, index + b, out + 4 * b);
+}
+
+#if PHILOX_X86
+
+__attribute__((target("avx2"), flatten))
+void blocksAvx2(uint64_t seed, uint64_t stream, uint64_t index, size_t count, uint32_t* out) {
+    runBlocks<8>(seed, stream, index, count, out);
+}
+
+__attribute__((target("avx512f"), flatten))
+void blocksAvx512(uint64_t seed, uint64_t stream, uint64_t index, size_t count, uint32_t* out) {
+    runBlocks<16>(seed, stream, index, count, out);
+}
+
+#endif // PHILOX_X86
+
+} // namespace
+
+Block block(uint64_t seed, uint64_t stream, uint64_t index) {
+    Block out;
+    scalarBlock(seed, stream, index, out.data());
+    return out;
+}
+
+void blocks(uint64_t seed, uint64_t stream, uint64_t index, size_t count, uint32_t* out) {
+    switch (cmpex::activeSimdLevel()) {
+#if PHILOX_X86
+    case cmpex::SimdLevel::AVX512: blocksAvx512(seed, stream, index, count, out); return;
+    case cmpex::SimdLevel::AVX2: blocksAvx2(seed, stream, index, count, out); return;
+#endif
+    default: runBlocks<4>(seed, stream, index, count, out); return;
+    }
+}
+
+} // namespace philox
+
+void CounterRng::fill(uint32_t* out, size_t n) {
+    size_t i = 0;
+    while (i < n && pos < 4)
+        out[i++] = buffer[pos++];
+    size_t whole = (n - i) / 4;
+    philox::blocks(key, stream_id, next_block, whole, out + i);
+    next_block += whole;
+    i += 4 * whole;
+    while (i < n)
+        out[i++] = (*this)();
+}
@@ -0,0 +1,66 @@
+#ifndef COUNTER_RNG_H
+#define COUNTER_RNG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+
+// Counter-based random numbers (Philox4x32-10). Output block i of stream s under seed k is
+// a keyed bijection of the counter (i, s), so any number of independent streams can be
+// derived from one seed without shared state: one per thread, per bucket or per use, and
+// each reproducible from (seed, stream) alone. Not a cryptographic generator; it stands
+// in for the enclave's randomness, as std::mt19937 did before.
+namespace philox {
+
+using Block = std::array<uint32_t, 4>;
+
+// The ten rounds on counter (c0, c1, c2, c3) with key (k0, k1).
+Block block(uint64_t seed, uint64_t stream, uint64_t index);
+
+// Blocks index..index+count-1 of a stream, written back to back (4 words per block).
+// Runs several blocks per vector register, with the width picked at runtime as for
+// the compare-exchange kernels (cmpex::activeSimdLevel()).
+void blocks(uint64_t seed, uint64_t stream, uint64_t index, size_t count, uint32_t* out);
+
+} // namespace philox
+
+// One Philox stream as a UniformRandomBitGenerator, so it also works with the <random>
+// distributions.
+class CounterRng {
+public:
+    using result_type = uint32_t;
+
+    explicit CounterRng(uint64_t seed = 0, uint64_t stream = 0) : key(seed), stream_id(stream) {}
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return UINT32_MAX; }
+
+    result_type operator()() {
+        if (pos == 4) {
+            buffer = philox::block(key, stream_id, next_block++);
+            pos = 0;
+        }
+        return buffer[pos++];
+    }
+
+    uint64_t next64() {
+        uint64_t hi = (*this)();
+        return (hi << 32) | (*this)();
+    }
+
+    // Writes the next n words, the same ones n calls of operator() would return; whole
+    // blocks are generated in vector batches.
+    void fill(uint32_t* out, size_t n);
+
+    uint64_t seed() const { return key; }
+    uint64_t stream() const { return stream_id; }
+
+private:
+    uint64_t key;
+    uint64_t stream_id;
+    uint64_t next_block = 0;
+    philox::Block buffer{};
+    int pos = 4;
+};
+
+#endif // COUNTER_RNG_H
@@ -0,0 +1,255 @@
+#include "distributed_sort.h"
+#include "merge_exchange.h"
+#include "bitonic_network.h"
+#include <stdexcept>
+#include <chrono>
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// ----- DistributedSorter Methods -----
+DistributedSorter::DistributedSorter(const DistributedSortConfig& cfg) : config(cfg) {
+    if (config.num_enclaves < 1 || (config.num_enclaves & (config.num_enclaves - 1)) != 0)
+        throw std::invalid_argument("The number of enclaves must be a power of two.");
+    pool = std::make_unique<ThreadPool>(config.num_threads);
+}
+
+// The flip form of the bitonic network, with enclaves in place of elements: for every
+// block size k, a flip round pairs i with the mirrored i ^ (k - 1), followed by
+// half-cleaner rounds pairing i with i + d for d = k/4, ..., 1. Every comparator keeps
+// the low half at the lower enclave, so all partitions stay ascending.
+std::vector<std::vector<std::pair<int, int>>> DistributedSorter::roundSchedule(int p) {
+    std::vector<std::vector<std::pair<int, int>>> rounds;
+    for (int k = 2; k <= p; k *= 2) {
+        std::vector<std::pair<int, int>> flip;
+        for (int b = 0; b < p; b += k)
+            for (int t = 0; t < k / 2; t++)
+                flip.emplace_back(b + t, b + k - 1 - t);
+        rounds.push_back(std::move(flip));
+        for (int d = k / 4; d > 0; d /= 2) {
+            std::vector<std::pair<int, int>> half;
+            for (int b = 0; b < p; b += 2 * d)
+                for (int t = 0; t < d; t++)
+                    half.emplace_back(b + t, b + t + d);
+            rounds.push_back(std::move(half));
+        }
+    }
+    return rounds;
+}
+
+std::vector<ElementTag> DistributedSorter::sort(const ElementStore& store, const std::vector<ElementTag>& tags) {
+    size_t p = static_cast<size_t>(config.num_enclaves);
+    size_t per_enclave = (tags.size() + p - 1) / p;
+    size_t padded = bitonic::nextPowerOfTwo(std::max<size_t>(per_enclave, 1));
+
+    last_stats = DistributedSortStats();
+    last_stats.partition_size = padded;
+    parts.assign(p, std::vector<ElementTag>());
+    for (size_t i = 0; i < p; i++) {
+        size_t begin = std::min(tags.size(), i * per_enclave);
+        size_t end = std::min(tags.size(), begin + per_enclave);
+        parts[i].reserve(padded);
+        parts[i].assign(tags.begin() + begin, tags.begin() + end);
+        parts[i].resize(padded, ElementTag{ 0, 0, 1 });
+    }
+
+    std::vector<std::vector<std::pair<int, int>>> rounds = roundSchedule(config.num_enclaves);
+    RoundPlan plan(rounds.size(), std::vector<std::pair<int, bool>>(p));
+    std::vector<std::pair<int, int>> links;
+    for (size_t r = 0; r < rounds.size(); r++) {
+        for (const auto& pair : rounds[r]) {
+            plan[r][pair.first] = { pair.second, true };
+            plan[r][pair.second] = { pair.first, false };
+            links.push_back(pair);
+        }
+    }
+    std::unique_ptr<PartitionTransport> transport = makePartitionTransport(config.transport, config.num_enclaves, links);
+    if (config.separate_processes)
+        runProcesses(store, plan, *transport);
+    else
+        runThreads(store, plan, *transport);
+
+    std::vector<ElementTag> sorted;
+    sorted.reserve(tags.size());
+    for (const auto& part : parts)
+        for (const auto& tag : part)
+            if (!tag.is_dummy)
+                sorted.push_back(tag);
+    return sorted;
+}
+
+void DistributedSorter::exchange(PartitionTransport& transport, const ElementStore& store, int i, int partner,
+                                 bool keep_low, const std::vector<ElementTag>& current, std::vector<ElementTag>& next) {
+    size_t P = current.size();
+    next.resize(P);
+    transport.receive(i, partner, P, [&](size_t offset, const ElementTag* chunk, size_t count) {
+        mergeExchangeFlip(store, current.data(), chunk, offset, count, P, keep_low, next.data());
+    });
+    store.mergeByValue(next, 0, P, true);
+}
+
+void DistributedSorter::runThreads(const ElementStore& store, const RoundPlan& plan, PartitionTransport& transport) {
+    size_t p = parts.size();
+
+    // Phase 1: independent local sorts, one task per enclave.
+    auto start = std::chrono::steady_clock::now();
+    pool->parallelFor(p, [&](size_t i) {
+        store.sortByValue(parts[i], 0, parts[i].size(), true);
+    });
+    last_stats.local_sort_ms = elapsedMs(start);
+
+    // Phase 2: every enclave posts its partition before any of them waits for its
+    // partner's, so the receive tasks never wait on a task that has not been scheduled.
+    std::vector<std::vector<ElementTag>> next(p);
+    for (const auto& round : plan) {
+        start = std::chrono::steady_clock::now();
+        uint64_t bytes_before = transport.bytesSent();
+        pool->parallelFor(p, [&](size_t i) {
+            transport.send(static_cast<int>(i), round[i].first, parts[i].data(), parts[i].size());
+        });
+        pool->parallelFor(p, [&](size_t i) {
+            exchange(transport, store, static_cast<int>(i), round[i].first, round[i].second, parts[i], next[i]);
+        });
+        for (size_t i = 0; i < p; i++)
+            transport.waitSends(static_cast<int>(i));
+        parts.swap(next);
+        last_stats.round_ms.push_back(elapsedMs(start));
+        last_stats.round_bytes.push_back(transport.bytesSent() - bytes_before);
+    }
+}
+
+static void writeAll(int fd, const void* data, size_t len) {
+    const char* bytes = static_cast<const char*>(data);
+    while (len > 0) {
+        ssize_t written = write(fd, bytes, len);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            throw std::runtime_error("Cannot write enclave result.");
+        bytes += written;
+        len -= static_cast<size_t>(written);
+    }
+}
+
+static void readAll(int fd, void* data, size_t len) {
+    char* bytes = static_cast<char*>(data);
+    while (len > 0) {
+        ssize_t got = read(fd, bytes, len);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            throw std::runtime_error("Enclave process ended without a result.");
+        bytes += got;
+        len -= static_cast<size_t>(got);
+    }
+}
+
+// Each enclave runs in a forked child that owns its partition and its ends of the links.
+// With no barrier between enclaves, an enclave starts sending as soon as its own local
+// sort or round is done. The child reports its final partition, its timings and its
+// bytes sent over a result socket.
+void DistributedSorter::runProcesses(const ElementStore& store, const RoundPlan& plan, PartitionTransport& transport) {
+    if (config.transport != TransportKind::UnixSocket)
+        throw std::invalid_argument("Separate enclave processes need the Unix socket transport.");
+    size_t p = parts.size();
+    size_t R = plan.size();
+    std::vector<int> results(p, -1);
+    std::vector<pid_t> children;
+
+    for (size_t i = 0; i < p; i++) {
+        int pair[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0)
+            throw std::runtime_error("Cannot create enclave result channel.");
+        pid_t pid = fork();
+        if (pid < 0)
+            throw std::runtime_error("Cannot fork enclave process.");
+        if (pid == 0) {
+            // Child: leave with _exit so that no state inherited from the parent (its
+            // thread pool in particular) is torn down here.
+            close(pair[0]);
+            for (int fd : results)
+                if (fd >= 0)
+                    close(fd);
+            transport.restrictTo(static_cast<int>(i));
+            int status = 0;
+            try {
+                int self = static_cast<int>(i);
+                std::vector<ElementTag> current = std::move(parts[i]);
+                std::vector<ElementTag> next;
+                std::vector<double> round_ms;
+                std::vector<uint64_t> round_bytes;
+                auto start = std::chrono::steady_clock::now();
+                store.sortByValue(current, 0, current.size(), true);
+                double local_ms = elapsedMs(start);
+                for (const auto& round : plan) {
+                    start = std::chrono::steady_clock::now();
+                    uint64_t bytes_before = transport.bytesSent();
+                    transport.send(self, round[i].first, current.data(), current.size());
+                    exchange(transport, store, self, round[i].first, round[i].second, current, next);
+                    transport.waitSends(self);
+                    current.swap(next);
+                    round_ms.push_back(elapsedMs(start));
+                    round_bytes.push_back(transport.bytesSent() - bytes_before);
+                }
+                writeAll(pair[1], current.data(), current.size() * sizeof(ElementTag));
+                writeAll(pair[1], &local_ms, sizeof(local_ms));
+                writeAll(pair[1], round_ms.data(), R * sizeof(double));
+                writeAll(pair[1], round_bytes.data(), R * sizeof(uint64_t));
+            }
+            catch (...) {
+                status = 1;
+            }
+            _exit(status);
+        }
+        close(pair[1]);
+        results[i] = pair[0];
+        children.push_back(pid);
+    }
+
+    // The children own the links now; a child that dies closes its ends and its
+    // partners fail instead of waiting forever.
+    transport.restrictTo(-1);
+
+    last_stats.round_ms.assign(R, 0.0);
+    last_stats.round_bytes.assign(R, 0);
+    std::string failure;
+    for (size_t i = 0; i < p; i++) {
+        try {
+            std::vector<double> round_ms(R);
+            std::vector<uint64_t> round_bytes(R);
+            double local_ms;
+            readAll(results[i], parts[i].data(), parts[i].size() * sizeof(ElementTag));
+            readAll(results[i], &local_ms, sizeof(local_ms));
+            readAll(results[i], round_ms.data(), R * sizeof(double));
+            readAll(results[i], round_bytes.data(), R * sizeof(uint64_t));
+            // A round lasts until its slowest enclave is done.
+            last_stats.local_sort_ms = std::max(last_stats.local_sort_ms, local_ms);
+            for (size_t r = 0; r < R; r++) {
+                last_stats.round_ms[r] = std::max(last_stats.round_ms[r], round_ms[r]);
+                last_stats.round_bytes[r] += round_bytes[r];
+            }
+        }
+        catch (const std::exception& ex) {
+            failure = ex.what();
+        }
+        close(results[i]);
+    }
+    for (pid_t pid : children) {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        if (failure.empty() && !(WIFEXITED(status) && WEXITSTATUS(status) == 0))
+            failure = "Enclave process failed.";
+    }
+    if (!failure.empty())
+        throw std::runtime_error(failure);
+}
+
+std::vector<std::string> DistributedSorter::sort(const std::vector<std::string>& values) {
+    ElementStore store = ElementStore::fromStrings(values);
+    return store.gather(sort(store, store.tags));
+}
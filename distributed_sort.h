@@ -0,0 +1,77 @@
+#ifndef DISTRIBUTED_SORT_H
+#define DISTRIBUTED_SORT_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <utility>
+#include <cstdint>
+#include "element_store.h"
+#include "thread_pool.h"
+#include "partition_transport.h"
+
+struct DistributedSortConfig {
+    // Simulated enclaves, one partition each. Must be a power of two.
+    int num_enclaves = 4;
+    // Threads shared by the enclaves (including the caller).
+    int num_threads = 1;
+    // How partitions travel between partners in the merge rounds.
+    TransportKind transport = TransportKind::InProcess;
+    // Run every enclave in its own forked process (needs TransportKind::UnixSocket);
+    // num_threads is then ignored.
+    bool separate_processes = false;
+};
+
+struct DistributedSortStats {
+    size_t partition_size = 0;   // Tags per enclave after padding.
+    double local_sort_ms = 0;    // Phase 1: every enclave sorts its partition.
+    std::vector<double> round_ms;  // Phase 2: one entry per merge-exchange round.
+    std::vector<uint64_t> round_bytes;  // Bytes sent between enclaves in each round.
+};
+
+// Distributed bitonic sort over simulated enclaves. Each enclave holds one partition of
+// tags, padded with dummies to a common power-of-two length, and sorts it locally; the
+// partitions are then combined with merge-exchange rounds (merge_exchange.h) following
+// the bitonic sorting network over enclaves. Each round pairs every enclave with exactly
+// one partner, so the pairs of a round run concurrently on the thread pool.
+//
+// Within a round every enclave sends its partition to its partner over the configured
+// transport and computes its own half from the partner's copy, chunk by chunk as the
+// data arrives. Results go to a second buffer per enclave, so a partition is never
+// modified while its partner may still be reading it.
+class DistributedSorter {
+public:
+    explicit DistributedSorter(const DistributedSortConfig& config = DistributedSortConfig());
+
+    // Sorts the tags by the payload values of store. Returns the real tags in ascending
+    // order; the padded per-enclave partitions stay available through partitions().
+    std::vector<ElementTag> sort(const ElementStore& store, const std::vector<ElementTag>& tags);
+
+    // Convenience form for plain strings.
+    std::vector<std::string> sort(const std::vector<std::string>& values);
+
+    const std::vector<std::vector<ElementTag>>& partitions() const { return parts; }
+    const DistributedSortStats& stats() const { return last_stats; }
+    const DistributedSortConfig& configuration() const { return config; }
+
+    // The merge-exchange rounds for p enclaves: each round lists its (low, high) pairs.
+    static std::vector<std::vector<std::pair<int, int>>> roundSchedule(int p);
+
+private:
+    // Partner and side of every enclave in every round: plan[r][i] = (partner, keep_low).
+    using RoundPlan = std::vector<std::vector<std::pair<int, bool>>>;
+
+    // Enclave i's part of one round: merges the partner's partition into next.
+    void exchange(PartitionTransport& transport, const ElementStore& store, int i, int partner, bool keep_low,
+                  const std::vector<ElementTag>& current, std::vector<ElementTag>& next);
+
+    void runThreads(const ElementStore& store, const RoundPlan& plan, PartitionTransport& transport);
+    void runProcesses(const ElementStore& store, const RoundPlan& plan, PartitionTransport& transport);
+
+    DistributedSortConfig config;
+    std::unique_ptr<ThreadPool> pool;
+    std::vector<std::vector<ElementTag>> parts;
+    DistributedSortStats last_stats;
+};
+
+#endif // DISTRIBUTED_SORT_H
@@ -0,0 +1,52 @@
+// distributed_sort_bench.cpp (Benchmark: distributed bitonic sort scaling with the thread count)
+// Usage: distributed_sort_bench [n = 1048576] [num_enclaves = 64] [max_threads = hardware threads]
+//                               [transport = inproc | socket]
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <random>
+#include <thread>
+#include <numeric>
+#include <algorithm>
+#include "distributed_sort.h"
+
+int main(int argc, char** argv) {
+    size_t n = argc > 1 ? std::stoul(argv[1]) : size_t(1) << 20;
+    int enclaves = argc > 2 ? std::stoi(argv[2]) : 64;
+    int max_threads = argc > 3 ? std::stoi(argv[3]) : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    TransportKind transport = argc > 4 && std::string(argv[4]) == "socket" ? TransportKind::UnixSocket
+                                                                           : TransportKind::InProcess;
+
+    std::mt19937 gen(7);
+    std::vector<std::string> values(n);
+    for (auto& v : values)
+        v = std::to_string(gen());
+    ElementStore store = ElementStore::fromStrings(values);
+
+    std::cout << "# n = " << n << ", enclaves = " << enclaves << ", transport = " << transportKindName(transport) << "\n";
+    std::cout << "threads,local_sort_ms,local_speedup,merge_rounds,merge_ms,bytes_per_round,total_ms,sorted\n";
+    double base_local = 0;
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        DistributedSortConfig config;
+        config.num_enclaves = enclaves;
+        config.num_threads = threads;
+        config.transport = transport;
+        DistributedSorter sorter(config);
+        std::vector<ElementTag> sorted = sorter.sort(store, store.tags);
+
+        const DistributedSortStats& stats = sorter.stats();
+        double merge_ms = std::accumulate(stats.round_ms.begin(), stats.round_ms.end(), 0.0);
+        uint64_t bytes_per_round = stats.round_bytes.empty() ? 0 : stats.round_bytes.front();
+        if (threads == 1)
+            base_local = stats.local_sort_ms;
+        bool ok = sorted.size() == n && std::is_sorted(sorted.begin(), sorted.end(),
+            [&store](const ElementTag& a, const ElementTag& b) { return store.before(a, b); });
+        std::cout << threads << "," << std::fixed << std::setprecision(3) << stats.local_sort_ms << ","
+                  << base_local / stats.local_sort_ms << "," << stats.round_ms.size() << ","
+                  << merge_ms << "," << bytes_per_round << "," << stats.local_sort_ms + merge_ms << "," << (ok ? "yes" : "no") << std::endl;
+        if (threads < max_threads && threads * 2 > max_threads)
+            threads = max_threads / 2;
+    }
+    return 0;
+}
@@ -0,0 +1,93 @@
+#include "element_store.h"
+#include "bitonic_network.h"
+#include <stdexcept>
+
+// ----- PayloadArena Methods -----
+uint32_t PayloadArena::append(std::string_view value) {
+    bytes.insert(bytes.end(), value.begin(), value.end());
+    offsets.push_back(bytes.size());
+    return static_cast<uint32_t>(offsets.size() - 2);
+}
+
+void PayloadArena::reserve(size_t count, size_t total_bytes) {
+    offsets.reserve(count + 1);
+    bytes.reserve(total_bytes);
+}
+
+void PayloadArena::clear() {
+    bytes.clear();
+    offsets.assign(1, 0);
+}
+
+// ----- ElementStore Methods -----
+template <typename Strings>
+static ElementStore buildFromStrings(const Strings& values) {
+    ElementStore store;
+    size_t total_bytes = 0;
+    for (const auto& s : values)
+        total_bytes += s.size();
+    store.payloads.reserve(values.size(), total_bytes);
+    store.tags.reserve(values.size());
+    for (const auto& s : values)
+        store.add(s);
+    return store;
+}
+
+ElementStore ElementStore::fromStrings(const std::vector<std::string>& values) {
+    return buildFromStrings(values);
+}
+
+ElementStore ElementStore::fromStrings(const std::vector<std::string_view>& values) {
+    return buildFromStrings(values);
+}
+
+ElementTag ElementStore::add(std::string_view value, int key) {
+    ElementTag tag{ key, payloads.append(value), 0 };
+    tags.push_back(tag);
+    return tag;
+}
+
+ElementTag ElementStore::addDummy() {
+    ElementTag tag{ 0, 0, 1 };
+    tags.push_back(tag);
+    return tag;
+}
+
+// Real elements first (in value order), dummies last, in either direction.
+static auto valueOrder(const PayloadArena& arena, bool ascending) {
+    return [&arena, ascending](const ElementTag& x, const ElementTag& y) {
+        if (x.is_dummy != y.is_dummy)
+            return x.is_dummy < y.is_dummy;
+        if (x.is_dummy)
+            return false;
+        return ascending ? arena.view(x.payload) < arena.view(y.payload)
+                         : arena.view(y.payload) < arena.view(x.payload);
+    };
+}
+
+bool ElementStore::before(const ElementTag& x, const ElementTag& y) const {
+    return valueOrder(payloads, true)(x, y);
+}
+
+void ElementStore::sortByValue(std::vector<ElementTag>& a, size_t low, size_t cnt, bool ascending) const {
+    auto order = valueOrder(payloads, ascending);
+    bitonic::BlendKernel<std::vector<ElementTag>::iterator, decltype(order)> kernel{ a.begin() + low, order };
+    bitonic::sortNetwork(cnt, kernel, bitonic::defaultTile<ElementTag>());
+}
+
+void ElementStore::mergeByValue(std::vector<ElementTag>& a, size_t low, size_t cnt, bool ascending) const {
+    if ((cnt & (cnt - 1)) != 0)
+        throw std::invalid_argument("mergeByValue requires a power-of-two length.");
+    auto order = valueOrder(payloads, ascending);
+    bitonic::BlendKernel<std::vector<ElementTag>::iterator, decltype(order)> kernel{ a.begin() + low, order };
+    bitonic::mergeNetwork(cnt, kernel, bitonic::defaultTile<ElementTag>());
+}
+
+std::vector<std::string> ElementStore::gather(const std::vector<ElementTag>& order) const {
+    std::vector<std::string> result;
+    result.reserve(order.size());
+    for (const auto& tag : order)
+        if (!tag.is_dummy)
+            result.emplace_back(payloads.view(tag.payload));
+    return result;
+}
@@ -0,0 +1,74 @@
+#ifndef ELEMENT_STORE_H
+#define ELEMENT_STORE_H
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+
+// Compact, fixed-width handle for one element. The sorting networks and the bucket
+// pipeline move only these 12-byte tags; the payload bytes stay in a PayloadArena and
+// are touched once, when the final order is materialized.
+struct ElementTag {
+    int key;
+    uint32_t payload;   // Index into the owning PayloadArena.
+    uint32_t is_dummy;  // 0 or 1. A full word keeps the record free of padding bytes.
+};
+
+// Append-only arena holding variable-length payloads back to back.
+class PayloadArena {
+public:
+    // Appends a payload and returns its index.
+    uint32_t append(std::string_view value);
+
+    std::string_view view(uint32_t index) const {
+        return std::string_view(bytes.data() + offsets[index], offsets[index + 1] - offsets[index]);
+    }
+
+    size_t size() const { return offsets.size() - 1; }
+    size_t byteSize() const { return bytes.size(); }
+
+    void reserve(size_t count, size_t total_bytes);
+    void clear();
+
+private:
+    std::vector<char> bytes;
+    std::vector<size_t> offsets{ 0 };
+};
+
+// Structure-of-arrays element storage: a packed tag array plus the payload arena.
+class ElementStore {
+public:
+    std::vector<ElementTag> tags;
+    PayloadArena payloads;
+
+    // Builds a store with one real tag per input string (key 0, payload i).
+    static ElementStore fromStrings(const std::vector<std::string>& values);
+    static ElementStore fromStrings(const std::vector<std::string_view>& values);
+
+    // Appends a real element and returns its tag.
+    ElementTag add(std::string_view value, int key = 0);
+
+    // Appends a dummy tag (no payload).
+    ElementTag addDummy();
+
+    std::string_view value(const ElementTag& tag) const { return payloads.view(tag.payload); }
+
+    // Value order of the networks below: real elements by payload value, then dummies.
+    bool before(const ElementTag& x, const ElementTag& y) const;
+
+    // Obliviously sorts a[low, low + cnt) by payload value with the bitonic network;
+    // dummies are ordered after all real elements. Only tags are moved.
+    void sortByValue(std::vector<ElementTag>& a, size_t low, size_t cnt, bool ascending) const;
+
+    // Merges the bitonic range a[low, low + cnt) (cnt a power of two) by payload value with
+    // the bitonic merge network; dummies are ordered after all real elements.
+    void mergeByValue(std::vector<ElementTag>& a, size_t low, size_t cnt, bool ascending) const;
+
+    // Applies a final order to the payloads: copies the value of every real tag in
+    // `order` into the result, once.
+    std::vector<std::string> gather(const std::vector<ElementTag>& order) const;
+};
+
+#endif // ELEMENT_STORE_H
@@ -0,0 +1,82 @@
+#include "final_sort.h"
+#include <algorithm>
+#include <array>
+
+namespace {
+
+struct ValueOrder {
+    const PayloadArena* arena;
+    bool operator()(const ElementTag& a, const ElementTag& b) const {
+        return arena->view(a.payload) < arena->view(b.payload);
+    }
+};
+
+// LSD radix sort with one counting pass per byte position, from the last position of the
+// longest payload down to the first. Digit 0 means "past the end of the payload", so
+// shorter strings order before their extensions exactly as in lexicographic comparison.
+void radixSort(std::vector<ElementTag>& tags, const PayloadArena& payloads) {
+    size_t width = 0;
+    for (const auto& tag : tags)
+        width = std::max(width, payloads.view(tag.payload).size());
+
+    std::vector<ElementTag> scratch(tags.size());
+    for (size_t pos = width; pos-- > 0;) {
+        std::array<size_t, 258> count{};
+        for (const auto& tag : tags) {
+            std::string_view v = payloads.view(tag.payload);
+            size_t digit = pos < v.size() ? 1 + static_cast<unsigned char>(v[pos]) : 0;
+            count[digit + 1]++;
+        }
+        for (size_t d = 1; d < count.size(); d++)
+            count[d] += count[d - 1];
+        for (const auto& tag : tags) {
+            std::string_view v = payloads.view(tag.payload);
+            size_t digit = pos < v.size() ? 1 + static_cast<unsigned char>(v[pos]) : 0;
+            scratch[count[digit]++] = tag;
+        }
+        tags.swap(scratch);
+    }
+}
+
+} // namespace
+
+const char* finalSortEngineName(FinalSortEngine engine) {
+    switch (engine) {
+    case FinalSortEngine::ParallelMerge: return "parallel-merge";
+    case FinalSortEngine::Radix: return "radix";
+    default: return "comparison";
+    }
+}
+
+const char* finalSortGuarantee(FinalSortEngine engine) {
+    switch (engine) {
+    case FinalSortEngine::ParallelMerge:
+        return "Comparison-based: after the oblivious random permutation, the merge and "
+               "comparison pattern depends only on a uniformly random order, so it reveals "
+               "nothing about the values beyond ties between equal keys. String comparisons "
+               "still take data-dependent time.";
+    case FinalSortEngine::Radix:
+        return "Not oblivious: the counting passes scatter by key byte, so the access pattern "
+               "reveals the byte histogram of every key position. Use only when key "
+               "distribution is not secret.";
+    default:
+        return "Comparison-based: after the oblivious random permutation, the comparison "
+               "pattern depends only on a uniformly random order, so it reveals nothing "
+               "about the values. String comparisons still take data-dependent time.";
+    }
+}
+
+void sortTagsByValue(std::vector<ElementTag>& tags, const PayloadArena& payloads,
+                     FinalSortEngine engine, ThreadPool* pool) {
+    switch (engine) {
+    case FinalSortEngine::ParallelMerge:
+        parallelMergeSort(tags, ValueOrder{ &payloads }, pool);
+        break;
+    case FinalSortEngine::Radix:
+        radixSort(tags, payloads);
+        break;
+    default:
+        std::sort(tags.begin(), tags.end(), ValueOrder{ &payloads });
+        break;
+    }
+}
@@ -0,0 +1,100 @@
+#ifndef FINAL_SORT_H
+#define FINAL_SORT_H
+
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <functional>
+#include "element_store.h"
+#include "thread_pool.h"
+#include "value_traits.h"
+
+// Engines for the last stage of the oblivious bucket sort, which orders the extracted
+// (already obliviously permuted) tags by payload value.
+enum class FinalSortEngine {
+    Comparison,     // std::sort.
+    ParallelMerge,  // Chunks sorted concurrently, then merged pairwise in parallel rounds.
+    Radix           // Stable LSD radix sort over the payload bytes.
+};
+
+const char* finalSortEngineName(FinalSortEngine engine);
+
+// Describes what an observer of the engine's memory accesses and timing can learn.
+const char* finalSortGuarantee(FinalSortEngine engine);
+
+// Sorts tags in place by payload value (lexicographic). Dummy tags must already have been
+// removed. pool may be null, in which case ParallelMerge runs on the calling thread.
+void sortTagsByValue(std::vector<ElementTag>& tags, const PayloadArena& payloads,
+                     FinalSortEngine engine, ThreadPool* pool);
+
+// ParallelMerge: equal chunks are sorted concurrently, then neighbouring runs are merged
+// in parallel rounds, ping-ponging between items and a scratch buffer. pool may be null.
+template <class T, class Less>
+void parallelMergeSort(std::vector<T>& items, Less less, ThreadPool* pool) {
+    size_t n = items.size();
+    size_t chunks = pool ? static_cast<size_t>(pool->size()) : 1;
+    if (chunks <= 1 || n < 2 * chunks) {
+        std::sort(items.begin(), items.end(), less);
+        return;
+    }
+
+    std::vector<size_t> bounds(chunks + 1);
+    for (size_t c = 0; c <= chunks; c++)
+        bounds[c] = n * c / chunks;
+    pool->parallelFor(chunks, [&](size_t c) {
+        std::sort(items.begin() + bounds[c], items.begin() + bounds[c + 1], less);
+    });
+
+    std::vector<T> scratch(n);
+    std::vector<T>* src = &items;
+    std::vector<T>* dst = &scratch;
+    for (size_t width = 1; width < chunks; width *= 2) {
+        size_t merges = (chunks + 2 * width - 1) / (2 * width);
+        pool->parallelFor(merges, [&](size_t m) {
+            size_t lo = bounds[std::min(chunks, 2 * width * m)];
+            size_t mid = bounds[std::min(chunks, 2 * width * m + width)];
+            size_t hi = bounds[std::min(chunks, 2 * width * (m + 1))];
+            std::merge(src->begin() + lo, src->begin() + mid, src->begin() + mid, src->begin() + hi,
+                dst->begin() + lo, less);
+        });
+        std::swap(src, dst);
+    }
+    if (src != &items)
+        items.swap(scratch);
+}
+
+// Radix: stable LSD radix sort over the ValueTraits<T> digits, one counting pass per
+// byte position.
+template <class T>
+void radixSortValues(std::vector<T>& values) {
+    using Traits = ValueTraits<T>;
+    std::vector<T> scratch(values.size());
+    for (size_t pos = Traits::radix_width; pos-- > 0;) {
+        std::array<size_t, 257> count{};
+        for (const T& v : values)
+            count[Traits::digit(v, pos) + 1]++;
+        for (size_t d = 1; d < count.size(); d++)
+            count[d] += count[d - 1];
+        for (const T& v : values)
+            scratch[count[Traits::digit(v, pos)]++] = v;
+        values.swap(scratch);
+    }
+}
+
+// Fixed-size counterpart of sortTagsByValue: sorts the values themselves with the engine.
+template <class T>
+void sortValues(std::vector<T>& values, FinalSortEngine engine, ThreadPool* pool) {
+    switch (engine) {
+    case FinalSortEngine::ParallelMerge:
+        parallelMergeSort(values, std::less<T>(), pool);
+        break;
+    case FinalSortEngine::Radix:
+        radixSortValues(values);
+        break;
+    default:
+        std::sort(values.begin(), values.end());
+        break;
+    }
+}
+
+#endif // FINAL_SORT_H
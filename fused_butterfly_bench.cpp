@@ -0,0 +1,56 @@
+// fused_butterfly_bench.cpp (Benchmark: butterfly levels fused per pass over untrusted memory)
+// Usage: fused_butterfly_bench [n = 1048576] [bucket_size = 256] [max_group = 64]
+//                              [num_threads = 1] [cipher = xor | aes-gcm]
+// Sorts the same n random integers with config.butterfly_group_bytes set to hold groups
+// of 2, 4, ... max_group buckets, and prints per run the levels per pass, the bytes moved
+// between the enclave and untrusted memory, the buckets encrypted and the network time.
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include "oblivious_sort.h"
+
+int main(int argc, char** argv) {
+    int n = argc > 1 ? std::stoi(argv[1]) : 1 << 20;
+    int Z = argc > 2 ? std::stoi(argv[2]) : 256;
+    int max_group = argc > 3 ? std::stoi(argv[3]) : 64;
+    int threads = argc > 4 ? std::stoi(argv[4]) : 1;
+    std::string cipher = argc > 5 ? argv[5] : "xor";
+
+    std::mt19937 gen(7);
+    std::vector<uint32_t> input(n);
+    for (auto& v : input)
+        v = gen();
+
+    try {
+        std::cout << "group_buckets,levels_per_pass,network_ms,total_ms,bytes_moved,buckets_sealed,sorted\n";
+        for (int group = 2; group <= max_group; group *= 2) {
+            FlatUntrustedMemory untrusted;
+            EnclaveConfig config;
+            config.num_threads = threads;
+            config.cipher = cipher == "aes-gcm" ? CipherKind::AesGcm : CipherKind::Xor;
+            config.butterfly_group_bytes = static_cast<size_t>(group) * Z * sizeof(ElementTag);
+            Enclave enclave(&untrusted, config);
+
+            auto start = std::chrono::steady_clock::now();
+            std::vector<uint32_t> out = enclave.oblivious_sort(input, Z);
+            auto stop = std::chrono::steady_clock::now();
+            double network_ms = enclave.phases.milliseconds("performButterflyNetwork");
+
+            std::cout << group << "," << enclave.fusedLevels(Z, enclave.last_parameters.L) << ","
+                      << std::fixed << std::setprecision(3) << network_ms << ","
+                      << std::chrono::duration<double, std::milli>(stop - start).count() << ","
+                      << enclave.transfer_stats.bytesMoved() << "," << enclave.transfer_stats.buckets_sealed << ","
+                      << (std::is_sorted(out.begin(), out.end()) && out.size() == input.size() ? "yes" : "no")
+                      << std::endl;
+        }
+    }
+    catch (const std::exception& ex) {
+        std::cerr << "Error: " << ex.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include "instrumentation.h"
+#include <algorithm>
+#include <tuple>
+
+uint32_t instrumentationThreadId() {
+    static std::atomic<uint32_t> next_id{ 0 };
+    thread_local uint32_t id = next_id.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
+
+// ----- AccessTrace Methods -----
+AccessTrace::AccessTrace(size_t capacity) : ring(kInstrumentationEnabled ? std::max<size_t>(capacity, 1) : 1) {}
+
+std::vector<AccessRecord> AccessTrace::records() const {
+    uint64_t n = total();
+    size_t held = static_cast<size_t>(std::min<uint64_t>(n, ring.size()));
+    std::vector<AccessRecord> out;
+    out.reserve(held);
+    for (uint64_t i = n - held; i < n; i++)
+        out.push_back(ring[i % ring.size()]);
+    return out;
+}
+
+// ----- PhaseTimes Methods -----
+double PhaseTimes::milliseconds(const char* name) const {
+    double total = 0;
+    for (const Phase& p : phases)
+        if (std::char_traits<char>::compare(p.name, name, std::char_traits<char>::length(name) + 1) == 0)
+            total += p.milliseconds();
+    return total;
+}
+
+// ----- Chrome Trace Export -----
+void writeChromeTrace(std::ostream& out, const PhaseTimes* phases, const AccessTrace* accesses) {
+    std::vector<AccessRecord> records;
+    if (accesses)
+        records = accesses->records();
+
+    // Timestamps are microseconds from the first event.
+    uint64_t origin = UINT64_MAX;
+    if (phases)
+        for (const auto& p : phases->entries())
+            origin = std::min(origin, p.start_ns);
+    for (const auto& r : records)
+        origin = std::min(origin, r.time_ns);
+    auto micros = [origin](uint64_t ns) { return (ns - origin) / 1000.0; };
+
+    out << "{\"traceEvents\":[\n";
+    bool first = true;
+    auto separator = [&]() -> std::ostream& {
+        if (!first)
+            out << ",\n";
+        first = false;
+        return out;
+    };
+    if (phases)
+        for (const auto& p : phases->entries())
+            separator() << "{\"name\":\"" << p.name << "\",\"cat\":\"phase\",\"ph\":\"X\",\"pid\":0,\"tid\":"
+                        << p.thread << ",\"ts\":" << micros(p.start_ns) << ",\"dur\":"
+                        << (p.end_ns - p.start_ns) / 1000.0 << "}";
+    for (const auto& r : records)
+        separator() << "{\"name\":\"" << (r.op == AccessOp::Read ? "read" : "write")
+                    << "\",\"cat\":\"access\",\"ph\":\"i\",\"s\":\"t\",\"pid\":0,\"tid\":" << r.thread
+                    << ",\"ts\":" << micros(r.time_ns) << ",\"args\":{\"level\":" << r.level
+                    << ",\"bucket\":" << r.bucket << ",\"bytes\":" << r.bytes << "}}";
+    out << "\n],\"displayTimeUnit\":\"ms\"";
+    if (accesses)
+        out << ",\"otherData\":{\"accesses\":" << accesses->total() << ",\"dropped\":" << accesses->dropped() << "}";
+    out << "}\n";
+}
+
+// ----- Trace Comparison -----
+// A step of the bucket network reads level l and writes level l + 1; the initial writes
+// of level 0 form step -1.
+static int stepOf(const AccessRecord& r) {
+    return r.op == AccessOp::Read ? r.level : r.level - 1;
+}
+
+static std::vector<AccessRecord> canonicalPattern(std::vector<AccessRecord> records) {
+    auto key = [](const AccessRecord& r) { return std::make_tuple(r.op, r.level, r.bucket, r.bytes); };
+    size_t begin = 0;
+    while (begin < records.size()) {
+        size_t end = begin + 1;
+        while (end < records.size() && stepOf(records[end]) == stepOf(records[begin]))
+            end++;
+        std::sort(records.begin() + begin, records.begin() + end,
+            [&key](const AccessRecord& x, const AccessRecord& y) { return key(x) < key(y); });
+        begin = end;
+    }
+    return records;
+}
+
+long firstPatternDifference(const std::vector<AccessRecord>& a, const std::vector<AccessRecord>& b,
+                            bool ignore_order_within_level) {
+    if (ignore_order_within_level)
+        return firstPatternDifference(canonicalPattern(a), canonicalPattern(b), false);
+    size_t common = std::min(a.size(), b.size());
+    for (size_t i = 0; i < common; i++)
+        if (!a[i].samePattern(b[i]))
+            return static_cast<long>(i);
+    return a.size() == b.size() ? -1 : static_cast<long>(common);
+}
@@ -0,0 +1,142 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <cstdint>
+#include <cstddef>
+
+// Instrumentation of the oblivious sort: a log of every bucket access seen by untrusted
+// storage and wall-clock timers for the phases of a sort. Build with
+// -DOBLIVIOUS_SORT_INSTRUMENT=0 to compile the recording out; the types stay available
+// and simply record nothing. The flag must be the same for every translation unit.
+#ifndef OBLIVIOUS_SORT_INSTRUMENT
+#define OBLIVIOUS_SORT_INSTRUMENT 1
+#endif
+
+constexpr bool kInstrumentationEnabled = OBLIVIOUS_SORT_INSTRUMENT != 0;
+
+inline uint64_t instrumentationClockNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Small per-thread number for trace output (0 for the first thread that records).
+uint32_t instrumentationThreadId();
+
+enum class AccessOp : uint8_t { Read, Write };
+
+// One bucket access as untrusted storage sees it.
+struct AccessRecord {
+    uint64_t time_ns;
+    int32_t level;
+    int32_t bucket;
+    uint32_t bytes;
+    uint16_t thread;
+    AccessOp op;
+
+    // What an observer of untrusted memory learns: everything except the timing.
+    bool samePattern(const AccessRecord& other) const {
+        return op == other.op && level == other.level && bucket == other.bucket && bytes == other.bytes;
+    }
+};
+
+// Fixed-capacity ring buffer of access records. The buffer is allocated up front; once it
+// is full the oldest records are overwritten and counted as dropped. record() is safe to
+// call from several threads; read the records only while nothing is recording.
+class AccessTrace {
+public:
+    explicit AccessTrace(size_t capacity = size_t(1) << 16);
+
+    void record(AccessOp op, int level, int bucket, size_t bytes) {
+        if constexpr (kInstrumentationEnabled) {
+            uint64_t n = next.fetch_add(1, std::memory_order_relaxed);
+            ring[n % ring.size()] = AccessRecord{ instrumentationClockNs(), level, bucket,
+                static_cast<uint32_t>(bytes), static_cast<uint16_t>(instrumentationThreadId()), op };
+        }
+    }
+
+    // Records still held, oldest first.
+    std::vector<AccessRecord> records() const;
+
+    // Total accesses recorded, including overwritten ones.
+    uint64_t total() const { return next.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { uint64_t n = total(); return n > ring.size() ? n - ring.size() : 0; }
+    size_t capacity() const { return ring.size(); }
+
+    void clear() { next.store(0, std::memory_order_relaxed); }
+
+private:
+    std::vector<AccessRecord> ring;
+    std::atomic<uint64_t> next{ 0 };
+};
+
+// Wall-clock intervals of the named phases of a sort, in the order they started.
+class PhaseTimes {
+public:
+    struct Phase {
+        const char* name;  // A string literal.
+        uint64_t start_ns;
+        uint64_t end_ns;
+        uint16_t thread;
+
+        double milliseconds() const { return (end_ns - start_ns) / 1e6; }
+    };
+
+    void record(const char* name, uint64_t start_ns, uint64_t end_ns) {
+        if constexpr (kInstrumentationEnabled)
+            phases.push_back(Phase{ name, start_ns, end_ns, static_cast<uint16_t>(instrumentationThreadId()) });
+    }
+
+    const std::vector<Phase>& entries() const { return phases; }
+
+    // Total time of every phase with this name.
+    double milliseconds(const char* name) const;
+
+    void clear() { phases.clear(); }
+
+private:
+    std::vector<Phase> phases;
+};
+
+// Times the enclosing scope as one phase. A null PhaseTimes records nothing.
+class ScopedPhase {
+public:
+    ScopedPhase(PhaseTimes* times, const char* name) : times(times), name(name) {
+        if constexpr (kInstrumentationEnabled)
+            if (times)
+                start_ns = instrumentationClockNs();
+    }
+    ~ScopedPhase() {
+        if constexpr (kInstrumentationEnabled)
+            if (times)
+                times->record(name, start_ns, instrumentationClockNs());
+    }
+
+    ScopedPhase(const ScopedPhase&) = delete;
+    ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+private:
+    PhaseTimes* times;
+    const char* name;
+    uint64_t start_ns = 0;
+};
+
+// Writes the phases and accesses in the Chrome trace event format (chrome://tracing,
+// Perfetto): phases as complete events, accesses as instant events carrying level,
+// bucket and bytes. Either argument may be null.
+void writeChromeTrace(std::ostream& out, const PhaseTimes* phases, const AccessTrace* accesses);
+
+// Obliviousness check: compares the access patterns (op, level, bucket, bytes) of two
+// traces and returns the index of the first difference, or -1 if they are identical.
+// The pairs of one butterfly level run in any order across threads, so with
+// ignore_order_within_level the records of each level are compared as a sorted multiset;
+// levels themselves must still come in the same order. Traces that dropped records are
+// compared on what they still hold.
+long firstPatternDifference(const std::vector<AccessRecord>& a, const std::vector<AccessRecord>& b,
+                            bool ignore_order_within_level = false);
+
+#endif // INSTRUMENTATION_H
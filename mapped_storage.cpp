@@ -0,0 +1,219 @@
+#include "mapped_storage.h"
+#include <stdexcept>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+static std::runtime_error systemError(const char* what) {
+    return std::runtime_error(std::string(what) + ": " + std::strerror(errno));
+}
+
+static const size_t kScratchBufferBytes = 1 << 20;
+
+static size_t pageSize() {
+    static const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return page;
+}
+
+std::string defaultScratchDirectory() {
+    const char* dir = std::getenv("TMPDIR");
+    return dir && *dir ? dir : "/tmp";
+}
+
+// ----- ScratchFile Methods -----
+ScratchFile::ScratchFile(const std::string& directory) {
+    std::string pattern = directory + "/oblivious_sort.XXXXXX";
+    std::vector<char> path(pattern.begin(), pattern.end());
+    path.push_back('\0');
+    fd = mkstemp(path.data());
+    if (fd < 0)
+        throw systemError("Cannot create scratch file");
+    unlink(path.data());
+}
+
+ScratchFile::~ScratchFile() {
+    if (fd >= 0)
+        close(fd);
+}
+
+void ScratchFile::append(const void* data, size_t len) {
+    if (buffer.size() < kScratchBufferBytes)
+        buffer.resize(kScratchBufferBytes);
+    const char* src = static_cast<const char*>(data);
+    while (len > 0) {
+        size_t chunk = std::min(len, buffer.size() - buffered);
+        std::memcpy(&buffer[buffered], src, chunk);
+        buffered += chunk;
+        src += chunk;
+        len -= chunk;
+        if (buffered == buffer.size())
+            flush();
+    }
+}
+
+void ScratchFile::flush() {
+    size_t done = 0;
+    while (done < buffered) {
+        ssize_t written = pwrite(fd, buffer.data() + done, buffered - done, file_size + done);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            throw systemError("Cannot write scratch file");
+        }
+        done += static_cast<size_t>(written);
+    }
+    file_size += buffered;
+    buffered = 0;
+}
+
+void ScratchFile::resize(size_t bytes) {
+    flush();
+    if (ftruncate(fd, static_cast<off_t>(bytes)) != 0)
+        throw systemError("Cannot resize scratch file");
+    file_size = bytes;
+}
+
+size_t ScratchFile::readAt(size_t offset, void* dst, size_t len) const {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t got = pread(fd, static_cast<char*>(dst) + done, len - done, static_cast<off_t>(offset + done));
+        if (got < 0) {
+            if (errno == EINTR)
+                continue;
+            throw systemError("Cannot read scratch file");
+        }
+        if (got == 0)
+            break;
+        done += static_cast<size_t>(got);
+    }
+    return done;
+}
+
+// ----- MappedRegion Methods -----
+MappedRegion::MappedRegion(ScratchFile& file, bool writable) {
+    file.flush();
+    length = file.size();
+    if (length == 0)
+        return;
+    int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+    void* addr = mmap(nullptr, length, prot, MAP_SHARED, file.descriptor(), 0);
+    if (addr == MAP_FAILED)
+        throw systemError("Cannot map scratch file");
+    base = static_cast<char*>(addr);
+}
+
+MappedRegion::~MappedRegion() {
+    if (base)
+        munmap(base, length);
+}
+
+MappedRegion::MappedRegion(MappedRegion&& other) noexcept : base(other.base), length(other.length) {
+    other.base = nullptr;
+    other.length = 0;
+}
+
+MappedRegion& MappedRegion::operator=(MappedRegion&& other) noexcept {
+    if (this != &other) {
+        if (base)
+            munmap(base, length);
+        base = other.base;
+        length = other.length;
+        other.base = nullptr;
+        other.length = 0;
+    }
+    return *this;
+}
+
+void MappedRegion::willNeed(size_t offset, size_t len) const {
+    if (!base || len == 0)
+        return;
+    // madvise wants a page-aligned start.
+    size_t begin = offset / pageSize() * pageSize();
+    madvise(base + begin, offset + len - begin, MADV_WILLNEED);
+}
+
+void MappedRegion::discard(size_t offset, size_t len) const {
+    if (!base || len == 0)
+        return;
+    // Only whole pages inside the range may be dropped; partial ones hold live neighbours.
+    size_t page = pageSize();
+    size_t begin = (offset + page - 1) / page * page;
+    size_t end = (offset + len) / page * page;
+    if (end <= begin)
+        return;
+    // MADV_REMOVE frees the file pages outright; file systems without hole punching fall
+    // back to dropping them from this mapping.
+    if (madvise(base + begin, end - begin, MADV_REMOVE) != 0)
+        madvise(base + begin, end - begin, MADV_DONTNEED);
+}
+
+// ----- MappedUntrustedMemory Methods -----
+MappedUntrustedMemory::MappedUntrustedMemory(const std::string& directory) : directory(directory) {
+    resident_level[0] = -1;
+    resident_level[1] = -1;
+}
+
+void MappedUntrustedMemory::allocate(int B, int L, int Z) {
+    region = MappedRegion();
+    num_buckets = B;
+    num_levels = L + 1;
+    bucket_size = Z;
+    size_t slot_bytes = 2 * num_buckets * bucket_size * sizeof(ElementTag);
+    size_t seal_bytes = 2 * num_buckets * sizeof(BucketSeal);
+
+    // A fresh file reads as zeros and takes no disk space until a level is written.
+    file = std::make_unique<ScratchFile>(directory);
+    file->resize(slot_bytes + seal_bytes);
+    region = MappedRegion(*file, true);
+    slots = reinterpret_cast<ElementTag*>(region.data());
+    seals = reinterpret_cast<BucketSeal*>(region.data() + slot_bytes);
+    madvise(region.data(), region.size(), MADV_SEQUENTIAL);
+    resident_level[0] = -1;
+    resident_level[1] = -1;
+}
+
+void MappedUntrustedMemory::checkBounds(int level, int bucket_index) const {
+    if (level < 0 || static_cast<size_t>(level) >= num_levels ||
+        bucket_index < 0 || static_cast<size_t>(bucket_index) >= num_buckets)
+        throw std::out_of_range("Bucket outside the mapped untrusted arena.");
+}
+
+ConstBucketView MappedUntrustedMemory::read_view(int level, int bucket_index) {
+    checkBounds(level, bucket_index);
+    if (resident_level[level % 2].load(std::memory_order_relaxed) != level)
+        throw std::logic_error("Level is no longer resident in the ping-pong buffers.");
+    traceAccess(AccessOp::Read, level, bucket_index, bucket_size);
+    return ConstBucketView{ slots + offset(level, bucket_index), bucket_size };
+}
+
+BucketView MappedUntrustedMemory::write_view(int level, int bucket_index) {
+    checkBounds(level, bucket_index);
+    resident_level[level % 2].store(level, std::memory_order_relaxed);
+    traceAccess(AccessOp::Write, level, bucket_index, bucket_size);
+    return BucketView{ slots + offset(level, bucket_index), bucket_size };
+}
+
+BucketSeal* MappedUntrustedMemory::seal_slot(int level, int bucket_index) {
+    checkBounds(level, bucket_index);
+    return &seals[(static_cast<size_t>(level) % 2) * num_buckets + bucket_index];
+}
+
+void MappedUntrustedMemory::prefetch(int level, int bucket_index) {
+    if (level < 0 || static_cast<size_t>(level) >= num_levels ||
+        bucket_index < 0 || static_cast<size_t>(bucket_index) >= num_buckets)
+        return;
+    region.willNeed(offset(level, bucket_index) * sizeof(ElementTag), bucket_size * sizeof(ElementTag));
+}
+
+void MappedUntrustedMemory::release_level(int level) {
+    if (level < 0 || static_cast<size_t>(level) >= num_levels)
+        return;
+    // Seals are small and stay mapped; only the slots are dropped.
+    size_t level_bytes = num_buckets * bucket_size * sizeof(ElementTag);
+    region.discard(offset(level, 0) * sizeof(ElementTag), level_bytes);
+}
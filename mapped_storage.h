@@ -0,0 +1,109 @@
+#ifndef MAPPED_STORAGE_H
+#define MAPPED_STORAGE_H
+
+#include <string>
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include "untrusted_storage.h"
+
+// Scratch file for out-of-core data. It is created in a directory and unlinked at once,
+// so it never outlives the process. Data is appended through a write buffer and can be
+// read back with readAt() or mapped as a whole.
+class ScratchFile {
+public:
+    explicit ScratchFile(const std::string& directory);
+    ~ScratchFile();
+
+    ScratchFile(const ScratchFile&) = delete;
+    ScratchFile& operator=(const ScratchFile&) = delete;
+
+    void append(const void* data, size_t len);
+
+    // Writes out the append buffer.
+    void flush();
+
+    // Bytes appended so far, including buffered ones.
+    size_t size() const { return file_size + buffered; }
+
+    // Sets the file length (after a flush); new bytes read as zero.
+    void resize(size_t bytes);
+
+    // Reads up to len bytes at offset and returns how many were read.
+    size_t readAt(size_t offset, void* dst, size_t len) const;
+
+    int descriptor() const { return fd; }
+
+private:
+    int fd = -1;
+    size_t file_size = 0;
+    std::string buffer;
+    size_t buffered = 0;
+};
+
+// Shared mapping of a whole ScratchFile. Unmapped on destruction.
+class MappedRegion {
+public:
+    MappedRegion() = default;
+    MappedRegion(ScratchFile& file, bool writable);
+    ~MappedRegion();
+
+    MappedRegion(MappedRegion&& other) noexcept;
+    MappedRegion& operator=(MappedRegion&& other) noexcept;
+
+    char* data() const { return base; }
+    size_t size() const { return length; }
+
+    // Paging hints for [offset, offset + len); both are best effort.
+    void willNeed(size_t offset, size_t len) const;
+    // The range is dead: its pages may be dropped without being written back.
+    void discard(size_t offset, size_t len) const;
+
+private:
+    char* base = nullptr;
+    size_t length = 0;
+};
+
+// Directory for scratch files: $TMPDIR, or /tmp.
+std::string defaultScratchDirectory();
+
+// Ping-pong level buffers in a memory-mapped scratch file, for sorts whose buckets do not
+// fit in RAM. The two buffers and their seals share one file with the same layout as
+// FlatUntrustedMemory in PingPong mode. The butterfly network reads and writes each level
+// front to back, so the kernel's readahead and writeback see long sequential runs;
+// prefetch() asks for the next pair ahead of time, and release_level() drops a consumed
+// level so its pages are neither written back nor kept in the page cache.
+class MappedUntrustedMemory : public UntrustedStorage {
+public:
+    explicit MappedUntrustedMemory(const std::string& directory = defaultScratchDirectory());
+
+    void allocate(int B, int L, int Z) override;
+    ConstBucketView read_view(int level, int bucket_index) override;
+    BucketView write_view(int level, int bucket_index) override;
+    BucketSeal* seal_slot(int level, int bucket_index) override;
+    void prefetch(int level, int bucket_index) override;
+    void release_level(int level) override;
+
+    // Size of the mapped file, in bytes.
+    size_t mappedBytes() const { return region.size(); }
+
+private:
+    size_t offset(int level, int bucket_index) const {
+        return ((static_cast<size_t>(level) % 2) * num_buckets + bucket_index) * bucket_size;
+    }
+    void checkBounds(int level, int bucket_index) const;
+
+    std::string directory;
+    std::unique_ptr<ScratchFile> file;
+    MappedRegion region;
+    ElementTag* slots = nullptr;
+    BucketSeal* seals = nullptr;
+    size_t num_buckets = 0;
+    size_t num_levels = 0;
+    size_t bucket_size = 0;
+
+    // The level currently held by each of the two buffers (see FlatUntrustedMemory).
+    std::atomic<int> resident_level[2];
+};
+
+#endif // MAPPED_STORAGE_H
@@ -0,0 +1,84 @@
+// memory_report.cpp (Peak untrusted- and trusted-memory footprint of the oblivious bucket sort)
+// Usage: memory_report <n> <bucket_size> [--run] [num_threads = 1] [epc_mib = 90]
+// Prints the bucket parameters, the arena size of each level-retention mode and the
+// butterfly's trusted working set. With --run, also sorts n random strings with a
+// ping-pong arena and reports the measured peak, and per phase the trusted working set
+// and the simulated EPC paging under an epc_mib budget.
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <random>
+#include "oblivious_sort.h"
+
+static std::string formatBytes(size_t bytes) {
+    const char* units[] = { "B", "KiB", "MiB", "GiB", "TiB" };
+    double value = static_cast<double>(bytes);
+    int unit = 0;
+    while (value >= 1024.0 && unit < 4) {
+        value /= 1024.0;
+        unit++;
+    }
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2) << value << " " << units[unit];
+    return out.str();
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: memory_report <n> <bucket_size> [--run]\n";
+        return 1;
+    }
+    int n = std::stoi(argv[1]);
+    int Z = std::stoi(argv[2]);
+    bool run = argc > 3 && std::string(argv[3]) == "--run";
+    int threads = argc > 4 ? std::stoi(argv[4]) : 1;
+    size_t epc_mib = argc > 5 ? std::stoul(argv[5]) : 90;
+
+    try {
+        FlatUntrustedMemory untrusted(LevelRetention::PingPong);
+        EnclaveConfig config;
+        config.num_threads = threads;
+        config.epc.budget_bytes = epc_mib << 20;
+        Enclave enclave(&untrusted, config);
+        auto [B, L] = enclave.computeBucketParameters(n, Z);
+
+        size_t ping_pong = FlatUntrustedMemory::footprintBytes(B, L, Z, LevelRetention::PingPong);
+        size_t history = FlatUntrustedMemory::footprintBytes(B, L, Z, LevelRetention::FullHistory);
+        std::cout << "n = " << n << ", Z = " << Z << ", B = " << B << ", L = " << L << "\n";
+        std::cout << "Padded slots per level: " << static_cast<size_t>(B) * Z
+                  << " (" << sizeof(ElementTag) << " bytes each)\n";
+        std::cout << "Peak untrusted footprint, ping-pong:    " << formatBytes(ping_pong) << "\n";
+        std::cout << "Peak untrusted footprint, full history: " << formatBytes(history) << "\n";
+        size_t per_thread = enclave.butterflyBytesPerThread(Z, L);
+        std::cout << "Butterfly trusted working set:          " << formatBytes(per_thread) << " per thread, "
+                  << formatBytes(per_thread * threads) << " for " << threads << " threads\n";
+
+        if (run) {
+            std::mt19937 gen(n);
+            std::vector<std::string> input(n);
+            for (auto& s : input)
+                s = std::to_string(gen());
+            enclave.oblivious_sort(input, Z);
+            std::cout << "Measured peak (ping-pong run):          " << formatBytes(untrusted.peakBytes()) << "\n";
+            const TrustedMemory& epc = enclave.trusted_memory;
+            std::cout << "\nTrusted memory, EPC budget " << formatBytes(epc.config().budget_bytes) << ":\n";
+            std::cout << std::left << std::setw(26) << "phase" << std::right << std::setw(14) << "peak"
+                      << std::setw(14) << "touched" << std::setw(12) << "page-ins" << std::setw(12) << "page-outs"
+                      << std::setw(14) << "paging ms" << "\n";
+            for (const auto& phase : epc.phases())
+                std::cout << std::left << std::setw(26) << phase.name << std::right << std::setw(14)
+                          << formatBytes(phase.peak_bytes) << std::setw(14) << formatBytes(phase.touched_bytes)
+                          << std::setw(12) << phase.page_ins << std::setw(12) << phase.page_outs << std::setw(14)
+                          << std::fixed << std::setprecision(3) << phase.pagingMs(epc.config()) << "\n";
+            std::cout << std::left << std::setw(26) << "total" << std::right << std::setw(14)
+                      << formatBytes(epc.peakBytes()) << std::setw(14) << "" << std::setw(12) << epc.pageIns()
+                      << std::setw(12) << epc.pageOuts() << std::setw(14) << epc.pagingMs() << "\n";
+        }
+    }
+    catch (const std::exception& ex) {
+        std::cerr << "Error: " << ex.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,54 @@
+#include "merge_exchange.h"
+#include <stdexcept>
+#include <cstdint>
+
+// Returns take ? b : a without branching on take.
+static inline ElementTag select(const ElementTag& a, const ElementTag& b, bool take) {
+    uint32_t mask = 0u - static_cast<uint32_t>(take);
+    ElementTag out;
+    out.key = static_cast<int>((static_cast<uint32_t>(a.key) & ~mask) | (static_cast<uint32_t>(b.key) & mask));
+    out.payload = (a.payload & ~mask) | (b.payload & mask);
+    out.is_dummy = (a.is_dummy & ~mask) | (b.is_dummy & mask);
+    return out;
+}
+
+static void checkLength(size_t P) {
+    if ((P & (P - 1)) != 0)
+        throw std::invalid_argument("Merge-exchange partitions must have a power-of-two length.");
+}
+
+void mergeExchange(const ElementStore& store, std::vector<ElementTag>& low, std::vector<ElementTag>& high) {
+    size_t P = low.size();
+    if (high.size() != P)
+        throw std::invalid_argument("Merge-exchange partitions must have the same length.");
+    checkLength(P);
+    for (size_t i = 0; i < P; i++) {
+        ElementTag a = low[i];
+        ElementTag b = high[P - 1 - i];
+        bool swap = store.before(b, a);
+        low[i] = select(a, b, swap);
+        high[P - 1 - i] = select(b, a, swap);
+    }
+    store.mergeByValue(low, 0, P, true);
+    store.mergeByValue(high, 0, P, true);
+}
+
+void mergeExchangeFlip(const ElementStore& store, const ElementTag* mine, const ElementTag* partner_chunk,
+                       size_t partner_offset, size_t len, size_t P, bool keep_low, ElementTag* out) {
+    for (size_t t = 0; t < len; t++) {
+        // The pair is (low[i], high[P - 1 - i]) from the low side's point of view; both
+        // sides decide with the same comparison so that ties split consistently.
+        size_t i = P - 1 - (partner_offset + t);
+        const ElementTag& other = partner_chunk[t];
+        bool swap = keep_low ? store.before(other, mine[i]) : store.before(mine[i], other);
+        out[i] = select(mine[i], other, swap);
+    }
+}
+
+void mergeExchangeSide(const ElementStore& store, std::vector<ElementTag>& mine,
+                       const ElementTag* partner, bool keep_low) {
+    size_t P = mine.size();
+    checkLength(P);
+    mergeExchangeFlip(store, mine.data(), partner, 0, P, P, keep_low, mine.data());
+    store.mergeByValue(mine, 0, P, true);
+}
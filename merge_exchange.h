@@ -0,0 +1,34 @@
+#ifndef MERGE_EXCHANGE_H
+#define MERGE_EXCHANGE_H
+
+#include <vector>
+#include "element_store.h"
+
+// Oblivious merge-exchange between two partners that each hold an ascending partition
+// of the same power-of-two length P (value order of ElementStore, dummies last).
+// Afterwards the low partner holds the P smallest elements of the union and the high
+// partner the P largest, both ascending.
+//
+// It is the last merge of a bitonic sort over the two partitions. The flip stage
+// compares low[i] with high[P - 1 - i] and picks with a mask rather than a branch; the
+// halves it leaves are bitonic and are finished by the local bitonic merge network.
+// The sequence of pairs compared and of slots written never depends on the data.
+
+// Both sides at once, for two partitions held in one address space. Works in place:
+// neither vector is reallocated or copied.
+void mergeExchange(const ElementStore& store, std::vector<ElementTag>& low, std::vector<ElementTag>& high);
+
+// One side, for a partner that has received a copy of the other partition. mine is
+// updated in place to the low (keep_low) or high half. Both sides of one exchange select
+// exactly complementary elements, including among equal values.
+void mergeExchangeSide(const ElementStore& store, std::vector<ElementTag>& mine,
+                       const ElementTag* partner, bool keep_low);
+
+// The flip stage of one side for partner[partner_offset, partner_offset + len), so that
+// it can run on each chunk of the partner's partition as it arrives. out[i] receives the
+// selected element for every mine[i] paired with that chunk (out may equal mine). Once
+// all P partner elements are processed, mergeByValue on out completes the side.
+void mergeExchangeFlip(const ElementStore& store, const ElementTag* mine, const ElementTag* partner_chunk,
+                       size_t partner_offset, size_t len, size_t P, bool keep_low, ElementTag* out);
+
+#endif // MERGE_EXCHANGE_H
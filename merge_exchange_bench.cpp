@@ -0,0 +1,90 @@
+// merge_exchange_bench.cpp (Benchmark: one distributed merge round, std::merge with copies vs. oblivious merge-exchange)
+// Usage: merge_exchange_bench [min_log2 = 10] [max_log2 = 20] [partitions = 8]
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include "element_store.h"
+#include "merge_exchange.h"
+
+// Reference: the original merge of distributed_bitonic_sort.cpp. It merges with
+// std::merge, copies out both halves, and the caller copies them back.
+static std::pair<std::vector<ElementTag>, std::vector<ElementTag>> copyingMerge(
+    const ElementStore& store, const std::vector<ElementTag>& a, const std::vector<ElementTag>& b) {
+    std::vector<ElementTag> merged(a.size() + b.size());
+    std::merge(a.begin(), a.end(), b.begin(), b.end(), merged.begin(),
+        [&store](const ElementTag& x, const ElementTag& y) { return store.before(x, y); });
+    size_t half = merged.size() / 2;
+    std::vector<ElementTag> lower(merged.begin(), merged.begin() + half);
+    std::vector<ElementTag> upper(merged.begin() + half, merged.end());
+    return { lower, upper };
+}
+
+// Random strings split into sorted partitions of P tags each.
+static std::vector<std::vector<ElementTag>> makePartitions(ElementStore& store, size_t P, int partitions, uint32_t seed) {
+    std::mt19937 gen(seed);
+    std::vector<std::vector<ElementTag>> parts(partitions);
+    for (auto& part : parts) {
+        for (size_t i = 0; i < P; i++)
+            part.push_back(store.add(std::to_string(gen())));
+        std::sort(part.begin(), part.end(), [&store](const ElementTag& x, const ElementTag& y) { return store.before(x, y); });
+    }
+    return parts;
+}
+
+static bool sortedPairs(const ElementStore& store, const std::vector<std::vector<ElementTag>>& parts) {
+    auto order = [&store](const ElementTag& x, const ElementTag& y) { return store.before(x, y); };
+    for (size_t i = 0; i + 1 < parts.size(); i += 2) {
+        if (!std::is_sorted(parts[i].begin(), parts[i].end(), order) ||
+            !std::is_sorted(parts[i + 1].begin(), parts[i + 1].end(), order) ||
+            order(parts[i + 1].front(), parts[i].back()))
+            return false;
+    }
+    return true;
+}
+
+template <class Fn>
+static double timeMs(Fn&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+int main(int argc, char** argv) {
+    int min_log = argc > 1 ? std::stoi(argv[1]) : 10;
+    int max_log = argc > 2 ? std::stoi(argv[2]) : 20;
+    int partitions = argc > 3 ? std::stoi(argv[3]) : 8;
+
+    std::cout << "# one round = " << partitions / 2 << " partner pairs\n";
+    std::cout << "log2(P),P,copying_merge_ms,merge_exchange_ms,merge_exchange_Melem_per_s,ok\n";
+    for (int lg = min_log; lg <= max_log; lg++) {
+        size_t P = size_t(1) << lg;
+        ElementStore store;
+        auto reference = makePartitions(store, P, partitions, lg);
+        auto parts = reference;
+
+        double copying_ms = timeMs([&] {
+            for (int i = 0; i + 1 < partitions; i += 2) {
+                auto merged = copyingMerge(store, reference[i], reference[i + 1]);
+                reference[i] = merged.first;
+                reference[i + 1] = merged.second;
+            }
+        });
+        double exchange_ms = timeMs([&] {
+            for (int i = 0; i + 1 < partitions; i += 2)
+                mergeExchange(store, parts[i], parts[i + 1]);
+        });
+        bool ok = sortedPairs(store, parts);
+        for (int i = 0; i < partitions; i++)
+            ok = ok && store.gather(parts[i]) == store.gather(reference[i]);
+        double elements = static_cast<double>(P) * (partitions / 2 * 2);
+        std::cout << lg << "," << P << "," << std::fixed << std::setprecision(3)
+                  << copying_ms << "," << exchange_ms << "," << elements / exchange_ms / 1000.0 << ","
+                  << (ok ? "yes" : "no") << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,108 @@
+#include "merge_split.h"
+#include "compare_exchange.h"
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+
+namespace {
+
+// Per-thread scratch, reused across bucket pairs. The tags go through the split networks
+// themselves: word i carries the key of tag i in its low 32 bits under the routing bits,
+// and rest[i] its payload and dummy flag. No tag is read or written at a position that
+// depends on the data.
+thread_local std::vector<uint64_t> words;
+thread_local std::vector<uint64_t> rest;
+
+void packRest(const ElementTag* combined, size_t n) {
+    rest.resize(n);
+    for (size_t i = 0; i < n; i++)
+        rest[i] = uint64_t(combined[i].payload) | uint64_t(combined[i].is_dummy) << 32;
+}
+
+void unpackTags(ElementTag* combined, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        combined[i] = ElementTag{ static_cast<int>(static_cast<uint32_t>(words[i])),
+                                  static_cast<uint32_t>(rest[i]), static_cast<uint32_t>(rest[i] >> 32) };
+}
+
+// Decides the output bucket of every tag and returns them as dest[i] (0 or 1). Reals go
+// by their key bit; the first Z - count0 dummies fill bucket 0 and the rest bucket 1.
+// Every tag is visited once with the same instruction sequence.
+void assignDestinations(const ElementTag* combined, int Z, int bit, std::vector<uint32_t>& dest) {
+    size_t n = 2 * static_cast<size_t>(Z);
+    int count0 = 0, count1 = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint32_t real = 1u - combined[i].is_dummy;
+        uint32_t b = (static_cast<uint32_t>(combined[i].key) >> bit) & 1u;
+        count0 += real & (1u - b);
+        count1 += real & b;
+    }
+    if (count0 > Z || count1 > Z)
+        throw std::overflow_error("Bucket overflow occurred in merge_split.");
+
+    int needed_dummies0 = Z - count0;
+    int dummies_seen = 0;
+    dest.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        uint32_t dummy = combined[i].is_dummy;
+        uint32_t b = (static_cast<uint32_t>(combined[i].key) >> bit) & 1u;
+        uint32_t dummy_dest = static_cast<uint32_t>(dummies_seen >= needed_dummies0);
+        uint32_t mask = 0u - dummy;
+        dest[i] = (dummy_dest & mask) | (b & ~mask);
+        dummies_seen += dummy;
+    }
+}
+
+void splitBitonic(ElementTag* combined, size_t n, const std::vector<uint32_t>& dest) {
+    // Composite key: 0 real/bucket 0, 1 dummy/bucket 0, 2 real/bucket 1, 3 dummy/bucket 1.
+    words.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        uint64_t composite = (dest[i] << 1) | combined[i].is_dummy;
+        words[i] = (composite << 32) | static_cast<uint32_t>(combined[i].key);
+    }
+    packRest(combined, n);
+    cmpex::sortKeyValue(words.data(), rest.data(), n, true);
+    unpackTags(combined, n);
+}
+
+// Tight order-preserving compaction (cmpex::compactWords): each tag bound for bucket 0
+// moves left by the number of bucket-1 tags before it.
+void splitCompaction(ElementTag* combined, size_t n, const std::vector<uint32_t>& dest) {
+    // Word layout: distance << 33 | marked << 32 | key.
+    words.resize(n);
+    uint64_t marked_before = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t marked = 1u - dest[i];
+        uint64_t distance = (i - marked_before) & (0 - marked);
+        words[i] = (distance << 33) | (marked << 32) | static_cast<uint32_t>(combined[i].key);
+        marked_before += marked;
+    }
+    packRest(combined, n);
+    cmpex::compactKeyValue(words.data(), rest.data(), n);
+    unpackTags(combined, n);
+}
+
+} // namespace
+
+const char* mergeSplitEngineName(MergeSplitEngine engine) {
+    switch (engine) {
+    case MergeSplitEngine::Compaction: return "compaction";
+    default: return "bitonic";
+    }
+}
+
+size_t mergeSplitScratchBytes(int Z) {
+    // dest, words and rest, for 2Z tags.
+    return 2 * static_cast<size_t>(Z) * (sizeof(uint32_t) + 2 * sizeof(uint64_t));
+}
+
+void mergeSplit(ElementTag* combined, int Z, int bit, MergeSplitEngine engine) {
+    size_t n = 2 * static_cast<size_t>(Z);
+    thread_local std::vector<uint32_t> dest;
+    assignDestinations(combined, Z, bit, dest);
+    if (engine == MergeSplitEngine::Compaction)
+        splitCompaction(combined, n, dest);
+    else
+        splitBitonic(combined, n, dest);
+}
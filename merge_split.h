@@ -0,0 +1,25 @@
+#ifndef MERGE_SPLIT_H
+#define MERGE_SPLIT_H
+
+#include "element_store.h"
+
+// MergeSplit of a bucket pair: the 2Z tags of two buckets are redistributed so that
+// output bucket 0 holds every real element whose key has bit `bit` clear and output
+// bucket 1 every real element whose bit is set, each padded to Z with dummies.
+enum class MergeSplitEngine {
+    Bitonic,    // Bitonic sort of all 2Z tags on a composite (bucket, dummy) key: O(Z log^2 Z).
+    Compaction  // Order-preserving oblivious compaction by shifts of 2^j: O(Z log Z).
+};
+
+const char* mergeSplitEngineName(MergeSplitEngine engine);
+
+// Splits combined[0, 2Z) in place: afterwards combined[0, Z) is output bucket 0 and
+// combined[Z, 2Z) is output bucket 1. Keys and payloads are preserved. Both engines put
+// the same elements in each output bucket; only the order inside a bucket differs.
+// Throws std::overflow_error if more than Z real elements go to one bucket.
+void mergeSplit(ElementTag* combined, int Z, int bit, MergeSplitEngine engine);
+
+// Per-thread scratch mergeSplit holds for buckets of Z tags, in bytes.
+size_t mergeSplitScratchBytes(int Z);
+
+#endif // MERGE_SPLIT_H
@@ -0,0 +1,54 @@
+// merge_split_bench.cpp (Benchmark: per-pair MergeSplit cost, bitonic sort vs. oblivious compaction)
+// Usage: merge_split_bench [min_Z = 64] [max_Z = 4096] [pairs = 2000]
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include "merge_split.h"
+#include "compare_exchange.h"
+
+// A bucket pair as the butterfly network sees it: each bucket half full of real tags
+// with random keys, the rest dummies.
+static std::vector<ElementTag> makePair(int Z, std::mt19937& gen) {
+    std::vector<ElementTag> combined(2 * static_cast<size_t>(Z));
+    for (size_t i = 0; i < combined.size(); i++) {
+        bool real = (i % static_cast<size_t>(Z)) < static_cast<size_t>(Z) / 2;
+        combined[i] = ElementTag{ static_cast<int>(gen() & 0xffff), static_cast<uint32_t>(i), real ? 0u : 1u };
+    }
+    return combined;
+}
+
+// Average microseconds per pair over `pairs` splits of freshly copied inputs.
+static double timePerPairUs(MergeSplitEngine engine, const std::vector<ElementTag>& input, int Z, int pairs) {
+    std::vector<ElementTag> work(input.size());
+    auto start = std::chrono::steady_clock::now();
+    for (int p = 0; p < pairs; p++) {
+        work = input;
+        mergeSplit(work.data(), Z, p % 16, engine);
+    }
+    auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(stop - start).count() / pairs;
+}
+
+int main(int argc, char** argv) {
+    int min_Z = argc > 1 ? std::stoi(argv[1]) : 64;
+    int max_Z = argc > 2 ? std::stoi(argv[2]) : 4096;
+    int pairs = argc > 3 ? std::stoi(argv[3]) : 2000;
+
+    std::mt19937 gen(42);
+    std::cout << "# compare-exchange kernel: " << cmpex::simdLevelName(cmpex::activeSimdLevel()) << "\n";
+    std::cout << "Z,bitonic_us_per_pair,compaction_us_per_pair,speedup\n";
+    for (int Z = min_Z; Z <= max_Z; Z *= 2) {
+        std::vector<ElementTag> input = makePair(Z, gen);
+        // Warm up the per-thread scratch buffers before timing.
+        timePerPairUs(MergeSplitEngine::Bitonic, input, Z, 1);
+        timePerPairUs(MergeSplitEngine::Compaction, input, Z, 1);
+        double bitonic_us = timePerPairUs(MergeSplitEngine::Bitonic, input, Z, pairs);
+        double compaction_us = timePerPairUs(MergeSplitEngine::Compaction, input, Z, pairs);
+        std::cout << Z << "," << std::fixed << std::setprecision(3)
+                  << bitonic_us << "," << compaction_us << "," << (bitonic_us / compaction_us) << std::endl;
+    }
+    return 0;
+}
@@ -1,59 +1,105 @@
 #include "oblivious_sort.h"
+#include "bitonic_network.h"
+#include "compare_exchange.h"
 #include <iostream>
 #include <algorithm>
 #include <random>
 #include <cstring>
-
-// Helper function to XOR encrypt/decrypt a string using the provided key.
-static std::string xor_encrypt_string(const std::string &s, int key) {
-    std::string result = s;
-    for (char &c : result) {
-        c = c ^ (key & 0xFF);
-    }
-    return result;
-}
+#include <limits>
 
 // ----- UntrustedMemory Methods -----
-std::vector<Element> UntrustedMemory::read_bucket(int level, int bucket_index) {
+std::vector<ElementTag> UntrustedMemory::read_bucket(int level, int bucket_index) {
+    std::lock_guard<std::mutex> lock(storage_mutex);
     std::pair<int, int> key = { level, bucket_index };
+    traceAccess(AccessOp::Read, level, bucket_index, storage[key].size());
     return storage[key];
 }
 
-void UntrustedMemory::write_bucket(int level, int bucket_index, const std::vector<Element>& bucket) {
+void UntrustedMemory::write_bucket(int level, int bucket_index, const std::vector<ElementTag>& bucket) {
+    std::lock_guard<std::mutex> lock(storage_mutex);
     std::pair<int, int> key = { level, bucket_index };
+    traceAccess(AccessOp::Write, level, bucket_index, bucket.size());
     storage[key] = bucket;
 }
 
-std::vector<std::string> UntrustedMemory::get_access_log() {
-    return access_log;
+void UntrustedMemory::allocate(int /*B*/, int /*L*/, int Z) {
+    std::lock_guard<std::mutex> lock(storage_mutex);
+    storage.clear();
+    seals.clear();
+    bucket_size = Z;
 }
 
-// ----- Enclave Methods -----
-Enclave::Enclave(UntrustedMemory* u) : untrusted(u) {
-    std::random_device rd;
-    rng.seed(rd());
+ConstBucketView UntrustedMemory::read_view(int level, int bucket_index) {
+    std::lock_guard<std::mutex> lock(storage_mutex);
+    auto it = storage.find({ level, bucket_index });
+    if (it == storage.end())
+        return ConstBucketView{};
+    traceAccess(AccessOp::Read, level, bucket_index, it->second.size());
+    return ConstBucketView{ it->second.data(), it->second.size() };
 }
 
-std::vector<Element> Enclave::encryptBucket(const std::vector<Element>& bucket) {
-    std::vector<Element> encrypted = bucket;
-    for (auto& elem : encrypted) {
-        if (!elem.is_dummy) {
-            elem.value = xor_encrypt_string(elem.value, encryption_key);
-            elem.key ^= encryption_key;
-        }
-    }
-    return encrypted;
+BucketView UntrustedMemory::write_view(int level, int bucket_index) {
+    std::lock_guard<std::mutex> lock(storage_mutex);
+    std::vector<ElementTag>& bucket = storage[{ level, bucket_index }];
+    bucket.resize(bucket_size);
+    traceAccess(AccessOp::Write, level, bucket_index, bucket.size());
+    return BucketView{ bucket.data(), bucket.size() };
 }
 
-std::vector<Element> Enclave::decryptBucket(const std::vector<Element>& bucket) {
-    std::vector<Element> decrypted = bucket;
-    for (auto& elem : decrypted) {
-        if (!elem.is_dummy) {
-            elem.value = xor_encrypt_string(elem.value, encryption_key);
-            elem.key ^= encryption_key;
-        }
+BucketSeal* UntrustedMemory::seal_slot(int level, int bucket_index) {
+    std::lock_guard<std::mutex> lock(storage_mutex);
+    return &seals[{ level, bucket_index }];
+}
+
+// ----- Enclave Methods -----
+Enclave::Enclave(UntrustedStorage* u, const EnclaveConfig& cfg)
+    : untrusted(u), config(cfg), trusted_memory(cfg.epc) {
+    if (config.seed) {
+        seed = *config.seed;
+    }
+    else {
+        std::random_device rd;
+        seed = (static_cast<uint64_t>(rd()) << 32) | rd();
     }
-    return decrypted;
+    rng = CounterRng(seed, 0);
+    pool = std::make_unique<ThreadPool>(config.num_threads,
+        config.work_stealing ? ThreadPool::Schedule::WorkStealing : ThreadPool::Schedule::Static);
+    cipher = makeBucketCipher(config.cipher);
+}
+
+static_assert(sizeof(ElementTag) == 12, "ElementTag is sealed as raw bytes and must have no padding.");
+
+// Associated data for a bucket: the epoch it was sealed in and its (level, bucket_index)
+// location.
+static void bucketLocation(uint64_t epoch, int level, int bucket_index, uint8_t aad[16]) {
+    std::memcpy(aad, &epoch, 8);
+    std::memcpy(aad + 8, &level, 4);
+    std::memcpy(aad + 12, &bucket_index, 4);
+}
+
+void Enclave::encryptBucket(const ElementTag* src, int level, int bucket_index) {
+    BucketView dst = untrusted->write_view(level, bucket_index);
+    uint8_t aad[16];
+    bucketLocation(bucket_epoch, level, bucket_index, aad);
+    cipher->seal(reinterpret_cast<const uint8_t*>(src), reinterpret_cast<uint8_t*>(dst.data),
+        dst.size * sizeof(ElementTag), aad, sizeof(aad), *untrusted->seal_slot(level, bucket_index));
+    transfer_stats.buckets_sealed.fetch_add(1, std::memory_order_relaxed);
+    transfer_stats.bytes_written.fetch_add(dst.size * sizeof(ElementTag) + sizeof(BucketSeal), std::memory_order_relaxed);
+}
+
+void Enclave::decryptBucket(int level, int bucket_index, ElementTag* dst) {
+    decryptView(untrusted->read_view(level, bucket_index), level, bucket_index, dst);
+}
+
+void Enclave::decryptView(ConstBucketView src, int level, int bucket_index, ElementTag* dst) {
+    if (src.empty())
+        throw std::logic_error("Bucket was never written to untrusted memory.");
+    uint8_t aad[16];
+    bucketLocation(bucket_epoch, level, bucket_index, aad);
+    cipher->open(reinterpret_cast<const uint8_t*>(src.data), reinterpret_cast<uint8_t*>(dst),
+        src.size * sizeof(ElementTag), aad, sizeof(aad), *untrusted->seal_slot(level, bucket_index));
+    transfer_stats.buckets_opened.fetch_add(1, std::memory_order_relaxed);
+    transfer_stats.bytes_read.fetch_add(src.size * sizeof(ElementTag) + sizeof(BucketSeal), std::memory_order_relaxed);
 }
 
 std::pair<int, int> Enclave::computeBucketParameters(int n, int Z) {
@@ -67,168 +113,490 @@ std::pair<int, int> Enclave::computeBucketParameters(int n, int Z) {
     return { B, L };
 }
 
-void Enclave::initializeBuckets(const std::vector<std::string>& input_array, int B, int Z) {
-    int n = input_array.size();
-    std::vector<Element> elements;
-    std::uniform_int_distribution<int> key_dist(0, B - 1);
-    for (const std::string &s : input_array) {
-        int random_key = key_dist(rng);
-        elements.push_back(Element{ s, random_key, false });
-    }
-    int group_size = (n + B - 1) / B;
-    std::vector<std::vector<Element>> groups(B);
-    for (int i = 0; i < B; i++) {
-        int start = i * group_size;
-        int end = std::min(start + group_size, n);
-        if (start < n)
-            groups[i] = std::vector<Element>(elements.begin() + start, elements.begin() + end);
-        else
-            groups[i] = std::vector<Element>(); // Empty group.
+BucketParameters Enclave::planBuckets(int n, int bucket_size) {
+    BucketParameters plan;
+    if (bucket_size == kAutoBucketSize) {
+        plan = chooseBucketParameters(n, config.target_failure_probability,
+                                      BucketCostModel::host(config.cipher, config.merge_split, config.bucket_shuffle));
     }
-    for (int i = 0; i < B; i++) {
-        std::vector<Element> bucket = groups[i];
-        while (bucket.size() < static_cast<size_t>(Z))
-            bucket.push_back(Element{ "", 0, true });
-        untrusted->write_bucket(0, i, encryptBucket(bucket));
+    else {
+        auto [B, L] = computeBucketParameters(n, bucket_size);
+        plan.Z = bucket_size;
+        plan.B = B;
+        plan.L = L;
+        plan.failure_probability = overflowProbability(n, B, bucket_size);
     }
+    last_parameters = plan;
+    return plan;
 }
 
-void Enclave::bitonicMerge(std::vector<Element>& a, int low, int cnt, bool ascending) {
-    if (cnt > 1) {
-        int k = cnt / 2;
-        for (int i = low; i < low + k; i++) {
-            if ((ascending && a[i].key > a[i + k].key) ||
-                (!ascending && a[i].key < a[i + k].key)) {
-                std::swap(a[i], a[i + k]);
-            }
-        }
-        bitonicMerge(a, low, k, ascending);
-        bitonicMerge(a, low + k, k, ascending);
-    }
+void Enclave::initializeBuckets(const std::vector<std::string>& input_array, int B, int Z) {
+    loadPayloads(input_array);
+    writeInitialBuckets(static_cast<int>(input_array.size()), B, Z);
 }
 
-void Enclave::bitonicSort(std::vector<Element>& a, int low, int cnt, bool ascending) {
-    if (cnt > 1) {
-        int k = cnt / 2;
-        bitonicSort(a, low, k, true);
-        bitonicSort(a, low + k, k, false);
-        bitonicMerge(a, low, cnt, ascending);
-    }
+void Enclave::loadPayloads(const std::vector<std::string>& input_array) {
+    size_t total_bytes = 0;
+    for (const std::string &s : input_array)
+        total_bytes += s.size();
+    payloads.clear();
+    payloads.reserve(input_array.size(), total_bytes);
+    for (const std::string &s : input_array)
+        payloads.append(s);
+    chargePayloads();
 }
 
-std::pair<std::vector<Element>, std::vector<Element>> Enclave::merge_split_bitonic(
-    const std::vector<Element>& bucket1,
-    const std::vector<Element>& bucket2,
-    int level, int total_levels, int Z) {
+void Enclave::chargePayloads() {
+    size_t bytes = payloads.byteSize() + (payloads.size() + 1) * sizeof(size_t);
+    payload_memory.release();
+    payload_memory = trusted_memory.charge(bytes);
+    trusted_memory.touch(bytes);
+}
 
-    int L = total_levels;
-    int bit_index = L - 1 - level;
+uint64_t Enclave::reserveStreams(uint64_t count) {
+    uint64_t first = next_stream;
+    next_stream += count;
+    return first;
+}
 
-    // Combine the two buckets into one vector (size 2Z).
-    std::vector<Element> combined = bucket1;
-    combined.insert(combined.end(), bucket2.begin(), bucket2.end());
+void Enclave::writeInitialBuckets(int n, int B, int Z, int first_bucket, uint32_t first_payload) {
+    // Each bucket takes the next group of elements, is padded with dummies, and is
+    // encrypted into its level-0 slots. Element i carries payload index first_payload + i.
+    // Bucket i draws its keys from its own stream, a batch of words masked to the B
+    // (a power of two) bucket indices, so the buckets are filled across the thread pool.
+    int group_size = (n + B - 1) / B;
+    uint64_t first_stream = reserveStreams(B);
+    pool->parallelFor(B, [&](size_t index) {
+        int i = static_cast<int>(index);
+        thread_local std::vector<ElementTag> bucket;
+        thread_local std::vector<uint32_t> keys;
+        bucket.resize(Z);
+        int start = std::min(i * group_size, n);
+        int end = std::min(start + group_size, n);
+        size_t bytes = static_cast<size_t>(Z) * sizeof(ElementTag) + (end - start) * sizeof(uint32_t);
+        TrustedMemory::Charge held = trusted_memory.charge(bytes);
+        trusted_memory.touch(bytes + static_cast<size_t>(Z) * sizeof(ElementTag));
+        keys.resize(end - start);
+        stream(first_stream + i).fill(keys.data(), keys.size());
+        for (int e = start; e < end; e++) {
+            int key = static_cast<int>(keys[e - start] & static_cast<uint32_t>(B - 1));
+            bucket[e - start] = ElementTag{ key, first_payload + static_cast<uint32_t>(e), 0 };
+        }
+        std::fill(bucket.begin() + (end - start), bucket.end(), ElementTag{ 0, 0, 1 });
+        encryptBucket(bucket.data(), 0, first_bucket + i);
+    });
+}
 
-    // Count the number of real elements assigned to each target bucket.
-    int count0 = 0, count1 = 0;
-    for (const auto& elem : combined) {
-        if (!elem.is_dummy) {
-            if (((elem.key >> bit_index) & 1) == 0)
-                count0++;
-            else
-                count1++;
+int Enclave::routeBuckets(int n, BucketParameters& plan, int arrays, const Level0Writer& write_level0) {
+    bool allocated = false;
+    int final_level = 0;
+    for (int restarts = 0;; restarts++) {
+        bucket_epoch = next_seal_id++;
+        {
+            SortPhase phase(*this, "initializeBuckets");
+            if (!allocated)
+                untrusted->allocate(arrays * plan.B, plan.L, plan.Z);
+            allocated = true;
+            write_level0(plan.Z);
         }
-    }
-    if (count0 > Z || count1 > Z)
-        throw std::overflow_error("Bucket overflow occurred in merge_split.");
-
-    // Determine how many dummy elements need to be assigned to each bucket.
-    int needed_dummies0 = Z - count0;
-    int needed_dummies1 = Z - count1;
-    int assigned_dummies0 = 0, assigned_dummies1 = 0;
-
-    for (auto& elem : combined) {
-        if (elem.is_dummy) {
-            if (assigned_dummies0 < needed_dummies0) {
-                elem.key = 1; // Tagged for bucket 0 dummy.
-                assigned_dummies0++;
-            }
-            else {
-                elem.key = 3; // Tagged for bucket 1 dummy.
-                assigned_dummies1++;
+        overflow_stats.networks++;
+        try {
+            SortPhase phase(*this, "performButterflyNetwork");
+            final_level = performButterflyNetwork(plan.B, plan.L, plan.Z, arrays);
+            break;
+        }
+        catch (const std::overflow_error&) {
+            overflow_stats.overflows++;
+            bool grow = config.overflow_policy == OverflowPolicy::Grow;
+            if (config.overflow_policy == OverflowPolicy::Throw || restarts >= config.max_overflow_retries ||
+                (grow && plan.Z > std::numeric_limits<int>::max() / 2)) {
+                overflow_stats.failures++;
+                throw;
             }
         }
+        // The partially written levels are simply overwritten by the next attempt.
+        if (config.overflow_policy == OverflowPolicy::Grow) {
+            plan.Z *= 2;
+            plan.failure_probability = overflowProbability(n, plan.B, plan.Z);
+            plan.predicted_ms = 0;
+            allocated = false;
+            overflow_stats.growths++;
+        }
         else {
-            int bit_val = (elem.key >> bit_index) & 1;
-            elem.key = (bit_val << 1); // 0 for bucket 0, 2 for bucket 1.
+            overflow_stats.reseeds++;
         }
     }
+    last_parameters = plan;
+    return final_level;
+}
+
+void Enclave::bitonicSort(std::vector<ElementTag>& a, int low, int cnt, bool ascending) {
+    if (cnt <= 1)
+        return;
+    sortByPackedKey(a, low, cnt, ascending);
+}
 
-    // Perform bitonic sort on the combined vector using the composite keys.
-    bitonicSort(combined, 0, combined.size(), true);
+std::pair<std::vector<ElementTag>, std::vector<ElementTag>> Enclave::merge_split_bitonic(
+    const std::vector<ElementTag>& bucket1,
+    const std::vector<ElementTag>& bucket2,
+    int level, int total_levels, int Z) {
+
+    // Combine the two buckets into one vector (size 2Z).
+    std::vector<ElementTag> combined = bucket1;
+    combined.insert(combined.end(), bucket2.begin(), bucket2.end());
+
+    mergeSplitInPlace(combined, level, total_levels, Z);
 
     // After sorting, the first Z elements belong to output bucket 0, and the next Z to output bucket 1.
-    std::vector<Element> out_bucket0(combined.begin(), combined.begin() + Z);
-    std::vector<Element> out_bucket1(combined.begin() + Z, combined.end());
+    std::vector<ElementTag> out_bucket0(combined.begin(), combined.begin() + Z);
+    std::vector<ElementTag> out_bucket1(combined.begin() + Z, combined.end());
 
     return { out_bucket0, out_bucket1 };
 }
 
-void Enclave::performButterflyNetwork(int B, int L, int Z) {
-    for (int level = 0; level < L; level++) {
-        for (int i = 0; i < B; i += 2) {
-            std::vector<Element> bucket1_enc = untrusted->read_bucket(level, i);
-            std::vector<Element> bucket2_enc = untrusted->read_bucket(level, i + 1);
-            std::vector<Element> bucket1 = decryptBucket(bucket1_enc);
-            std::vector<Element> bucket2 = decryptBucket(bucket2_enc);
-            auto [out_bucket0, out_bucket1] = merge_split_bitonic(bucket1, bucket2, level, L, Z);
-            untrusted->write_bucket(level + 1, i, encryptBucket(out_bucket0));
-            untrusted->write_bucket(level + 1, i + 1, encryptBucket(out_bucket1));
-        }
+void Enclave::mergeSplitInPlace(std::vector<ElementTag>& combined, int level, int total_levels, int Z) {
+    // Level `level` splits on key bit L-1-level, most significant first.
+    mergeSplit(combined.data(), Z, total_levels - 1 - level, config.merge_split);
+}
+
+int Enclave::fusedLevels(int Z, int L) const {
+    size_t bucket_bytes = static_cast<size_t>(Z) * sizeof(ElementTag);
+    int k = 1;
+    while (k < L && (bucket_bytes << (k + 1)) <= config.butterfly_group_bytes)
+        k++;
+    return k;
+}
+
+size_t Enclave::butterflyBytesPerThread(int Z, int L) const {
+    int k = fusedLevels(Z, L);
+    size_t bucket_bytes = static_cast<size_t>(Z) * sizeof(ElementTag);
+    return (bucket_bytes << k) + (k > 1 ? 2 * bucket_bytes : 0) + mergeSplitScratchBytes(Z);
+}
+
+int Enclave::sortPasses(size_t n) {
+    int passes = 1;
+    while (passes < 64 && (size_t(1) << passes) < n)
+        passes++;
+    return passes;
+}
+
+int Enclave::performButterflyNetwork(int B, int L, int Z, int arrays) {
+    int k_max = fusedLevels(Z, L);
+    int stage = 0;
+    for (int level = 0; level < L; stage++) {
+        // A pass runs levels level..level+k-1. They split on bits L-level-k..L-1-level of
+        // the bucket index, so a group is the 2^k buckets that differ only in those bits:
+        // member j of a group sits j * 2^(L-level-k) buckets after member 0. After the k
+        // levels every element of the group is in place for the next pass.
+        int k = std::min(k_max, L - level);
+        int members = 1 << k;
+        int low_bits = L - level - k;
+        int groups_per_array = B >> k;
+        int groups = arrays * groups_per_array;
+        size_t bucket_bytes = static_cast<size_t>(Z) * sizeof(ElementTag);
+        // Each group is decrypted and encrypted once, and every one of its k levels runs
+        // members / 2 MergeSplits, each sweeping a pair and the scratch.
+        uint64_t group_touched = 2 * (static_cast<uint64_t>(bucket_bytes) << k) +
+            static_cast<uint64_t>(k) * (members / 2) * (4 * bucket_bytes + mergeSplitScratchBytes(Z));
+        auto member = [=](int g, int j) {
+            int q = g % groups_per_array;
+            int low = q & ((1 << low_bits) - 1);
+            return (g / groups_per_array) * B + ((q >> low_bits) << (L - level)) + (j << low_bits) + low;
+        };
+        // parallelFor returns only when every group of this pass is written (pass barrier).
+        // The untrusted storage sees one level per pass: stage is read, stage + 1 written.
+        pool->parallelFor(groups, [&](size_t index) {
+            int g = static_cast<int>(index);
+            // With a static schedule this thread most likely takes the next group; ask the
+            // storage to start loading it while this one is processed.
+            if (g + 1 < groups)
+                for (int j = 0; j < members; j++)
+                    untrusted->prefetch(stage, member(g + 1, j));
+            // Per-thread enclave buffer for the group; buckets are decrypted straight into it
+            // and the outputs are encrypted straight into the next stage's slots.
+            thread_local std::vector<ElementTag> group, pair;
+            TrustedMemory::Charge held = trusted_memory.charge(butterflyBytesPerThread(Z, L));
+            trusted_memory.touch(group_touched);
+            group.resize(static_cast<size_t>(members) * Z);
+            for (int j = 0; j < members; j++)
+                decryptBucket(stage, member(g, j), group.data() + static_cast<size_t>(j) * Z);
+            for (int m = 0; m < k; m++) {
+                // Level level + m pairs the members that differ in bit k-1-m of j.
+                int s = 1 << (k - 1 - m);
+                int bit = L - 1 - (level + m);
+                for (int j = 0; j < members; j++) {
+                    if (j & s)
+                        continue;
+                    ElementTag* lo = group.data() + static_cast<size_t>(j) * Z;
+                    ElementTag* hi = lo + static_cast<size_t>(s) * Z;
+                    if (s == 1) {
+                        mergeSplit(lo, Z, bit, config.merge_split);
+                        continue;
+                    }
+                    pair.resize(2 * static_cast<size_t>(Z));
+                    std::copy(lo, lo + Z, pair.begin());
+                    std::copy(hi, hi + Z, pair.begin() + Z);
+                    mergeSplit(pair.data(), Z, bit, config.merge_split);
+                    std::copy(pair.begin(), pair.begin() + Z, lo);
+                    std::copy(pair.begin() + Z, pair.end(), hi);
+                }
+            }
+            for (int j = 0; j < members; j++)
+                encryptBucket(group.data() + static_cast<size_t>(j) * Z, stage + 1, member(g, j));
+        });
+        untrusted->release_level(stage);
+        level += k;
     }
+    return stage;
 }
 
 // NEW: Oblivious permutation for a bucket using constant local storage.
 // For each element in the bucket, assign a uniformly random label (stored in key)
 // and then obliviously sort the bucket based on these labels.
-void Enclave::obliviousPermuteBucket(std::vector<Element>& bucket) {
+void Enclave::obliviousPermuteBucket(std::vector<ElementTag>& bucket) {
     for (auto &elem : bucket) {
          elem.key = rng();
     }
     bitonicSort(bucket, 0, bucket.size(), true);
 }
 
-std::vector<Element> Enclave::extractFinalElements(int B, int L) {
-    std::vector<Element> final_elements;
-    for (int i = 0; i < B; i++) {
-        std::vector<Element> bucket_enc = untrusted->read_bucket(L, i);
-        std::vector<Element> bucket = decryptBucket(bucket_enc);
-        // Instead of using a non-oblivious shuffle, perform an oblivious permutation.
-        obliviousPermuteBucket(bucket);
-        for (const auto& elem : bucket)
-            if (!elem.is_dummy)
-                final_elements.push_back(elem);
-    }
+size_t Enclave::extractFinalBucket(int level, int bucket_index, std::vector<ElementTag>& bucket, CounterRng bucket_rng) {
+    untrusted->prefetch(level, bucket_index + 1);  // Buckets are extracted in order.
+    ConstBucketView src = untrusted->read_view(level, bucket_index);
+    bucket.resize(src.size);
+    decryptView(src, level, bucket_index, bucket.data());
+    // Instead of using a non-oblivious shuffle, perform an oblivious permutation, which
+    // also moves the reals to the front.
+    bucket.resize(shuffleBucket(bucket.data(), bucket.size(), bucket_rng, config.bucket_shuffle));
+    return src.size;
+}
+
+std::vector<ElementTag> Enclave::extractFinalElements(int B, int level) {
+    std::vector<ElementTag> final_elements = extractFinalRange(level, 0, B);
+    untrusted->release_level(level);
     return final_elements;
 }
 
-std::vector<std::string> Enclave::finalSort(const std::vector<Element>& final_elements) {
-    std::vector<Element> sorted_elements = final_elements;
-    std::sort(sorted_elements.begin(), sorted_elements.end(),
-        [](const Element& a, const Element& b) {
-            return a.value < b.value; // Lexicographical order.
-        });
+std::vector<ElementTag> Enclave::extractFinalRange(int level, int first_bucket, int count) {
+    // Every bucket has its own random stream, so the buckets can be taken in any order.
+    // Each thread extracts one contiguous range of buckets, in order, into its own part;
+    // the parts are then copied into an output of exactly the real count.
+    uint64_t first_stream = reserveStreams(count);
+    size_t chunks = std::max<size_t>(1, std::min<size_t>(pool->size(), count));
+    std::vector<std::vector<ElementTag>> parts(chunks);
+    pool->parallelFor(chunks, [&](size_t c) {
+        int lo = static_cast<int>(count * c / chunks);
+        int hi = static_cast<int>(count * (c + 1) / chunks);
+        thread_local std::vector<ElementTag> bucket;
+        // Charged at the size of the buckets actually read, which need not match any plan.
+        TrustedMemory::Charge held;
+        for (int b = lo; b < hi; b++) {
+            size_t Z = extractFinalBucket(level, first_bucket + b, bucket, stream(first_stream + b));
+            size_t bucket_bytes = Z * sizeof(ElementTag) + shuffleScratchBytes(Z);
+            if (b == lo)
+                held = trusted_memory.charge(bucket_bytes);
+            trusted_memory.touch(bucket_bytes + Z * sizeof(ElementTag));
+            parts[c].insert(parts[c].end(), bucket.begin(), bucket.end());
+        }
+    });
+    size_t real_bytes = 0;
+    for (const auto& part : parts)
+        real_bytes += part.size() * sizeof(ElementTag);
+    TrustedMemory::Charge parts_memory = trusted_memory.charge(real_bytes);
+    trusted_memory.touch(real_bytes);
+    if (chunks == 1)
+        return std::move(parts[0]);
+    std::vector<size_t> offsets(chunks + 1, 0);
+    for (size_t c = 0; c < chunks; c++)
+        offsets[c + 1] = offsets[c] + parts[c].size();
+    TrustedMemory::Charge output_memory = trusted_memory.charge(real_bytes);
+    trusted_memory.touch(real_bytes);
+    std::vector<ElementTag> final_elements(offsets[chunks]);
+    pool->parallelFor(chunks, [&](size_t c) {
+        std::copy(parts[c].begin(), parts[c].end(), final_elements.begin() + offsets[c]);
+    });
+    return final_elements;
+}
+
+std::vector<std::string> Enclave::finalSort(std::vector<ElementTag> final_elements) {
+    size_t tag_bytes = final_elements.size() * sizeof(ElementTag);
+    size_t output_bytes = final_elements.size() * sizeof(std::string) + payloads.byteSize();
+    TrustedMemory::Charge tag_memory = trusted_memory.charge(tag_bytes);
+    TrustedMemory::Charge output_memory = trusted_memory.charge(output_bytes);
+    // The sort sweeps the tags and compares payload bytes; the output copies every payload.
+    trusted_memory.touch((tag_bytes + payloads.byteSize()) * sortPasses(final_elements.size()) + output_bytes);
+    sortTagsByValue(final_elements, payloads, config.final_sort, pool.get());
+    // Apply the final permutation to the payloads once.
     std::vector<std::string> sorted_values;
-    for (const auto& elem : sorted_elements)
-        sorted_values.push_back(elem.value);
+    sorted_values.reserve(final_elements.size());
+    for (const auto& elem : final_elements)
+        sorted_values.emplace_back(payloads.view(elem.payload));
     return sorted_values;
 }
 
 std::vector<std::string> Enclave::oblivious_sort(const std::vector<std::string>& input_array, int bucket_size) {
     int n = input_array.size();
-    int Z = bucket_size;
-    auto [B, L] = computeBucketParameters(n, Z);
-    initializeBuckets(input_array, B, Z);
-    performButterflyNetwork(B, L, Z);
-    std::vector<Element> final_elements = extractFinalElements(B, L);
-    return finalSort(final_elements);
-}
\ No newline at end of file
+    BucketParameters plan = planBuckets(n, bucket_size);
+    {
+        SortPhase phase(*this, "loadPayloads");
+        loadPayloads(input_array);
+    }
+    int final_level = routeBuckets(n, plan, 1, [&](int Z) { writeInitialBuckets(n, plan.B, Z); });
+    std::vector<ElementTag> final_elements;
+    {
+        SortPhase phase(*this, "extractFinalElements");
+        final_elements = extractFinalElements(plan.B, final_level);
+    }
+    SortPhase phase(*this, "finalSort");
+    return finalSort(std::move(final_elements));
+}
+
+void Enclave::runBatch(const std::vector<size_t>& sizes, int bucket_size, const BatchLoad& load,
+                       const BatchFinish& finish) {
+    // Arrays with the same (B, Z) share a pass, and so the same L. With kAutoBucketSize
+    // every array gets its own plan, and arrays of similar size end up together.
+    std::map<std::pair<int, int>, std::vector<size_t>> groups;
+    std::map<size_t, BucketParameters> plans;
+    for (size_t a = 0; a < sizes.size(); a++) {
+        if (sizes[a] > static_cast<size_t>(std::numeric_limits<int>::max()))
+            throw std::overflow_error("Input too large for the bucket parameters.");
+        auto it = plans.find(sizes[a]);
+        if (it == plans.end())
+            it = plans.emplace(sizes[a], planBuckets(static_cast<int>(sizes[a]), bucket_size)).first;
+        groups[{ it->second.B, it->second.Z }].push_back(a);
+    }
+
+    for (const auto& [layout, arrays] : groups) {
+        auto [B, Z] = layout;
+        size_t largest = 0;
+        for (size_t a : arrays)
+            largest = std::max(largest, sizes[a]);
+        size_t per_pass = std::max<size_t>(1, config.batch_slot_budget / (static_cast<size_t>(B) * Z));
+        per_pass = std::min<size_t>(per_pass, std::numeric_limits<int>::max() / B);
+        for (size_t start = 0; start < arrays.size(); start += per_pass) {
+            std::vector<size_t> members(arrays.begin() + start, arrays.begin() + std::min(arrays.size(), start + per_pass));
+            int G = static_cast<int>(members.size());
+            std::vector<uint32_t> first_payload(G);
+            uint64_t total = 0;
+            for (int k = 0; k < G; k++) {
+                first_payload[k] = static_cast<uint32_t>(total);
+                total += sizes[members[k]];
+            }
+            if (total > std::numeric_limits<uint32_t>::max())
+                throw std::overflow_error("Too many payloads for 32-bit indices.");
+
+            {
+                SortPhase phase(*this, "loadPayloads");
+                load(members, first_payload);
+            }
+            // Every array of the pass restarts together; the plan describes the largest.
+            BucketParameters plan = plans.at(largest);
+            int final_level = routeBuckets(static_cast<int>(largest), plan, G, [&](int Z) {
+                for (int k = 0; k < G; k++)
+                    writeInitialBuckets(static_cast<int>(sizes[members[k]]), plan.B, Z, k * plan.B, first_payload[k]);
+            });
+            std::vector<std::vector<ElementTag>> final_elements(G);
+            {
+                SortPhase phase(*this, "extractFinalElements");
+                for (int k = 0; k < G; k++)
+                    final_elements[k] = extractFinalRange(final_level, k * B, B);
+                untrusted->release_level(final_level);
+            }
+            TrustedMemory::Charge tag_memory = trusted_memory.charge(total * sizeof(ElementTag));
+            SortPhase phase(*this, "finalSort");
+            trusted_memory.touch(total * sizeof(ElementTag) * sortPasses(largest));
+            pool->parallelFor(G, [&](size_t k) {
+                finish(members[k], first_payload[k], final_elements[k]);
+            });
+        }
+    }
+}
+
+std::vector<std::vector<std::string>> Enclave::oblivious_sort_batch(
+    const std::vector<std::vector<std::string>>& inputs, int bucket_size) {
+    std::vector<size_t> sizes(inputs.size());
+    for (size_t a = 0; a < inputs.size(); a++)
+        sizes[a] = inputs[a].size();
+    std::vector<std::vector<std::string>> outputs(inputs.size());
+    runBatch(sizes, bucket_size,
+        [&](const std::vector<size_t>& members, const std::vector<uint32_t>&) {
+            // The pass's payloads, in member order, so indices match first_payload.
+            size_t count = 0, total_bytes = 0;
+            for (size_t a : members)
+                for (const std::string& s : inputs[a]) {
+                    count++;
+                    total_bytes += s.size();
+                }
+            payloads.clear();
+            payloads.reserve(count, total_bytes);
+            for (size_t a : members)
+                for (const std::string& s : inputs[a])
+                    payloads.append(s);
+            chargePayloads();
+        },
+        [&](size_t array, uint32_t, std::vector<ElementTag>& tags) {
+            // Each array is sorted by one thread; the pool is busy with the other arrays.
+            sortTagsByValue(tags, payloads, config.final_sort, nullptr);
+            std::vector<std::string>& out = outputs[array];
+            out.reserve(tags.size());
+            for (const auto& elem : tags)
+                out.emplace_back(payloads.view(elem.payload));
+        });
+    return outputs;
+}
+
+void Enclave::oblivious_sort_stream(StringSource& input, StringSink& output, int bucket_size,
+                                    const StreamingOptions& options) {
+    // Phases as in oblivious_sort; here loadPayloads spools the input, extractFinalElements
+    // also sorts and spills the runs, and finalSort is the merge of the runs into the sink.
+    auto initialize = std::make_unique<SortPhase>(*this, "loadPayloads");
+    PayloadSpool spool(options.scratch_directory, *cipher, next_seal_id++);
+    std::string value;
+    while (input.next(value))
+        spool.append(value);
+    spool.seal();
+    if (spool.size() > static_cast<size_t>(std::numeric_limits<int>::max()))
+        throw std::overflow_error("Input too large for the bucket parameters.");
+
+    int n = static_cast<int>(spool.size());
+    BucketParameters plan = planBuckets(n, bucket_size);
+    initialize.reset();
+    int final_level = routeBuckets(n, plan, 1, [&](int Z) { writeInitialBuckets(n, plan.B, Z); });
+    int B = plan.B;
+
+    // External final sort: real elements of consecutive final buckets are gathered into a
+    // run until it holds about options.run_bytes, sorted with config.final_sort and spilled.
+    SortedRuns runs(options.scratch_directory, *cipher, next_seal_id++, options.block_bytes);
+    std::vector<ElementTag> run;
+    PayloadArena run_payloads;
+    auto spillRun = [&]() {
+        if (run.empty())
+            return;
+        size_t run_size = run_payloads.byteSize() + run.size() * sizeof(ElementTag);
+        trusted_memory.touch(run_size * (sortPasses(run.size()) + 1));
+        sortTagsByValue(run, run_payloads, config.final_sort, pool.get());
+        runs.addRun(run, run_payloads);
+        run.clear();
+        run_payloads.clear();
+    };
+    auto extract = std::make_unique<SortPhase>(*this, "extractFinalElements");
+    // The run and its payloads stay in the enclave until spilled; the spool is untrusted.
+    TrustedMemory::Charge run_memory = trusted_memory.charge(options.run_bytes);
+    std::vector<ElementTag> bucket;
+    uint64_t first_stream = reserveStreams(B);
+    for (int i = 0; i < B; i++) {
+        extractFinalBucket(final_level, i, bucket, stream(first_stream + i));
+        for (ElementTag elem : bucket) {
+            spool.read(elem.payload, value);
+            elem.payload = run_payloads.append(value);
+            run.push_back(elem);
+        }
+        if (run_payloads.byteSize() + run.size() * sizeof(ElementTag) >= options.run_bytes)
+            spillRun();
+    }
+    untrusted->release_level(final_level);
+    spillRun();
+    extract.reset();
+    SortPhase phase(*this, "finalSort");
+    runs.merge(output, &trusted_memory);
+}
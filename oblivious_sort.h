@@ -10,83 +10,609 @@
 #include <stdexcept>
 #include <algorithm>
 #include <utility>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <cstdint>
+#include <optional>
+#include <cstring>
+#include <type_traits>
+#include "element_store.h"
+#include "thread_pool.h"
+#include "untrusted_storage.h"
+#include "final_sort.h"
+#include "merge_split.h"
+#include "bucket_shuffle.h"
+#include "stream_io.h"
+#include "instrumentation.h"
+#include "bitonic_network.h"
+#include "compare_exchange.h"
+#include "value_traits.h"
+#include "bucket_tuning.h"
+#include "counter_rng.h"
+#include "trusted_memory.h"
 
 // Represents a data element. For real elements, is_dummy is false.
-struct Element {
-    std::string value;  // Changed from int to std::string.
+// The bucket pipeline itself moves ElementTags (element_store.h); BasicElement remains the
+// self-contained form used with the bitonicSort API, which orders elements by key.
+template <class Value>
+struct BasicElement {
+    Value value;
     int key;
     bool is_dummy;
 };
 
+using Element = BasicElement<std::string>;
+
 // UntrustedMemory simulates untrusted storage (outside the enclave) that holds encrypted buckets.
-class UntrustedMemory {
+// This map-based backend is the reference implementation; FlatUntrustedMemory
+// (untrusted_storage.h) is the preallocated backend used for large inputs.
+class UntrustedMemory : public UntrustedStorage {
 public:
-    // Storage: keys are (level, bucket_index) and values are encrypted buckets.
-    std::map<std::pair<int, int>, std::vector<Element>> storage;
-    std::vector<std::string> access_log;
+    // Storage: keys are (level, bucket_index) and values are encrypted buckets of tags.
+    std::map<std::pair<int, int>, std::vector<ElementTag>> storage;
+    std::map<std::pair<int, int>, BucketSeal> seals;
+
+    // Every bucket read and write, in order (ring buffer; see instrumentation.h).
+    AccessTrace access_log;
+
+    // Serializes access to storage so buckets can be read and written from several threads.
+    std::mutex storage_mutex;
+
+    // Bucket capacity Z set by allocate().
+    int bucket_size = 0;
+
+    UntrustedMemory() { setAccessTrace(&access_log); }
+
+    // UntrustedStorage interface. read_view never inserts a missing bucket.
+    void allocate(int B, int L, int Z) override;
+    ConstBucketView read_view(int level, int bucket_index) override;
+    BucketView write_view(int level, int bucket_index) override;
+    BucketSeal* seal_slot(int level, int bucket_index) override;
 
     // Read an encrypted bucket from untrusted memory.
-    std::vector<Element> read_bucket(int level, int bucket_index);
+    std::vector<ElementTag> read_bucket(int level, int bucket_index);
 
     // Write an encrypted bucket to untrusted memory.
-    void write_bucket(int level, int bucket_index, const std::vector<Element>& bucket);
+    void write_bucket(int level, int bucket_index, const std::vector<ElementTag>& bucket);
 
     // Retrieve the access log.
-    std::vector<std::string> get_access_log();
+    const AccessTrace& get_access_log() const { return access_log; }
+};
+
+// Pass as bucket_size to let the enclave choose Z and B for each input from
+// config.target_failure_probability and a calibration of this host (bucket_tuning.h).
+constexpr int kAutoBucketSize = 0;
+
+// What a sort does when a MergeSplit overflows (more than Z real elements for one bucket).
+// Whether that happens depends only on the random keys and n, never on the values, so a
+// restart reveals nothing about the input; every attempt has the usual access pattern.
+enum class OverflowPolicy {
+    Throw,   // Rethrow the std::overflow_error.
+    Reseed,  // Rewrite level 0 with fresh random keys in the same buffers and restart.
+    Grow     // Restart with fresh keys and Z doubled (same B, so the levels are reallocated).
+};
+
+// Overflow counters of an Enclave, accumulated over all of its sorts.
+struct OverflowStats {
+    uint64_t networks = 0;   // Butterfly networks started, restarts included.
+    uint64_t overflows = 0;  // Networks stopped by a bucket overflow.
+    uint64_t reseeds = 0;    // Restarts at the same Z.
+    uint64_t growths = 0;    // Restarts with a larger Z.
+    uint64_t failures = 0;   // Sorts that ran out of restarts and threw.
+
+    double overflowRate() const { return networks ? static_cast<double>(overflows) / networks : 0; }
+};
+
+// Traffic between an Enclave and its untrusted storage, accumulated over all of its sorts.
+// A bucket counts as its Z slots plus its seal; every bucket read is also one decryption
+// and every bucket written one encryption.
+struct TransferStats {
+    std::atomic<uint64_t> bytes_read{ 0 };
+    std::atomic<uint64_t> bytes_written{ 0 };
+    std::atomic<uint64_t> buckets_opened{ 0 };
+    std::atomic<uint64_t> buckets_sealed{ 0 };
+
+    uint64_t bytesMoved() const { return bytes_read.load() + bytes_written.load(); }
+    void reset() {
+        bytes_read = 0;
+        bytes_written = 0;
+        buckets_opened = 0;
+        buckets_sealed = 0;
+    }
+};
+
+// Execution options for an Enclave.
+struct EnclaveConfig {
+    // Threads used by performButterflyNetwork; 1 processes the bucket pairs sequentially.
+    int num_threads = 1;
+    // Balance bucket pairs dynamically when their costs are uneven.
+    bool work_stealing = false;
+    // Cipher for buckets in untrusted memory and the scratch files of a streaming sort.
+    CipherKind cipher = CipherKind::Xor;
+    // Engine for the final sort of the extracted elements (see finalSortGuarantee()).
+    FinalSortEngine final_sort = FinalSortEngine::Comparison;
+    // Engine for the MergeSplit of each bucket pair in the butterfly network.
+    MergeSplitEngine merge_split = MergeSplitEngine::Bitonic;
+    // Permutation and compaction of each final bucket (see bucketShuffleGuarantee()).
+    BucketShuffle bucket_shuffle = BucketShuffle::LabelSort;
+    // Overflow probability accepted when the enclave chooses the bucket parameters
+    // itself (bucket_size == kAutoBucketSize); see bucket_tuning.h.
+    double target_failure_probability = 1e-12;
+    // Recovery from a bucket overflow, and the most restarts per sort before the
+    // std::overflow_error is rethrown anyway.
+    OverflowPolicy overflow_policy = OverflowPolicy::Throw;
+    int max_overflow_retries = 3;
+    // Trusted memory per worker for fused butterfly passes. A pass loads a group of 2^k
+    // buckets (2^k * Z tags), runs k levels on it and writes it back, for the largest k
+    // whose group fits; the untrusted traffic and the cipher work drop by about k. Below
+    // four buckets' worth (the default 0 included) every pass is a single level.
+    size_t butterfly_group_bytes = 0;
+    // Simulated EPC: budget, page size and paging cost (trusted_memory.h).
+    EpcConfig epc;
+    // Seed of the enclave's random streams. Unset, every Enclave draws one from
+    // std::random_device; set it for reproducible benchmark and regression runs.
+    std::optional<uint64_t> seed;
+    // Batch sorts: most bucket slots per level in one pass over the untrusted arena;
+    // larger groups of arrays are split into several passes. The default keeps a level
+    // (3 MiB of tags) cache-sized while giving the pool many pairs per barrier.
+    size_t batch_slot_budget = size_t(1) << 18;
 };
 
 // Enclave represents the trusted SGX enclave. It decrypts data from untrusted memory,
 // performs the oblivious sort operations, and reencrypts data when writing back.
 class Enclave {
 public:
-    UntrustedMemory* untrusted;
-    std::mt19937 rng; // Random number generator.
+    UntrustedStorage* untrusted;
+    EnclaveConfig config;
 
-    // A fixed key for our simulated encryption.
-    static constexpr int encryption_key = 0xdeadbeef;
+    // Seed of every random stream of this enclave: config.seed, or drawn from
+    // std::random_device. Stream 0 is rng, for sequential use; the sort reserves fresh
+    // streams for each step (one per bucket), so a fixed seed reproduces a run whatever
+    // the thread count.
+    uint64_t seed;
+    CounterRng rng;
+
+    // Stream id of this enclave's seed, and the first of count fresh stream ids.
+    CounterRng stream(uint64_t id) const { return CounterRng(seed, id); }
+    uint64_t reserveStreams(uint64_t count);
+    uint64_t next_stream = 1;
+
+    // Workers for the butterfly network (config.num_threads in total, including the caller).
+    std::unique_ptr<ThreadPool> pool;
+
+    // Cipher selected by config.cipher.
+    std::unique_ptr<BucketCipher> cipher;
+
+    // Ids bound into the associated data of everything this enclave seals. Every attempt
+    // of every sort seals its buckets under a fresh epoch, and every scratch file of a
+    // streaming sort gets a fresh file id, both from next_seal_id, so a ciphertext from an
+    // earlier sort or attempt, or from another file, does not verify in its place.
+    uint64_t next_seal_id = 1;
+    uint64_t bucket_epoch = 0;
+
+    // Wall-clock time of the phases of each sort (loadPayloads for strings,
+    // initializeBuckets, performButterflyNetwork, extractFinalElements, finalSort),
+    // appended per sort. A restart after an overflow adds its own initializeBuckets and
+    // performButterflyNetwork. Each typed bitonicSort or bitonicMerge call adds one phase.
+    PhaseTimes phases;
+
+    // Bucket overflows and restarts under config.overflow_policy.
+    OverflowStats overflow_stats;
+
+    // Bytes and buckets moved through encryptBucket and decryptBucket.
+    TransferStats transfer_stats;
+
+    // Trusted working set and simulated EPC paging of every phase, for all sorts. Each
+    // step charges the buffers it allocates in the enclave (the payload arena, the tags,
+    // per-thread buckets and scratch, the output) and the bytes it touches.
+    TrustedMemory trusted_memory;
+
+    // Times the enclosing scope as a phase of a sort and accounts its trusted memory.
+    struct SortPhase {
+        ScopedPhase time;
+        TrustedMemory::Phase memory;
+        SortPhase(Enclave& enclave, const char* name)
+            : time(&enclave.phases, name), memory(&enclave.trusted_memory, name) {}
+    };
+
+    // Payloads of the current sort. Only their tags travel through the bucket network;
+    // the bytes are read once, by finalSort.
+    PayloadArena payloads;
+    TrustedMemory::Charge payload_memory;
+
+    // Charges the payload arena, as just filled, in place of its previous contents.
+    void chargePayloads();
 
     // Constructor: initializes the enclave with a pointer to untrusted memory.
-    Enclave(UntrustedMemory* u);
+    Enclave(UntrustedStorage* u, const EnclaveConfig& cfg = EnclaveConfig());
+
+    // Encrypts the Z tags at src as one buffer, straight into the slots of untrusted bucket
+    // (level, bucket_index), and stores its seal. Dummies are encrypted like real elements,
+    // and (bucket_epoch, level, bucket_index) is authenticated as associated data.
+    void encryptBucket(const ElementTag* src, int level, int bucket_index);
 
-    // Simulated encryption: XOR each field with encryption_key.
-    static std::vector<Element> encryptBucket(const std::vector<Element>& bucket);
+    // Decrypts untrusted bucket (level, bucket_index) straight into dst (Z tags).
+    // Throws std::runtime_error if authentication fails.
+    void decryptBucket(int level, int bucket_index, ElementTag* dst);
 
-    // Simulated decryption.
-    static std::vector<Element> decryptBucket(const std::vector<Element>& bucket);
+    // Same, for a view of that bucket already obtained from untrusted storage.
+    void decryptView(ConstBucketView src, int level, int bucket_index, ElementTag* dst);
 
     // Computes the bucket parameters (B: number of buckets, L: number of levels)
     // given the input size n and bucket capacity Z.
     std::pair<int, int> computeBucketParameters(int n, int Z);
 
-    // Step 1: Initializes buckets by assigning random keys, partitioning the input, and padding with dummies.
+    // Bucket parameters for a sort of n elements: computeBucketParameters for a fixed
+    // bucket_size, or chooseBucketParameters with the host cost model for
+    // kAutoBucketSize. Also stored in last_parameters.
+    BucketParameters planBuckets(int n, int bucket_size);
+
+    // Parameters of the most recent planBuckets call, with their failure probability and,
+    // when chosen automatically, their predicted cost.
+    BucketParameters last_parameters;
+
+    // Step 1: Stores the payloads in the arena, then initializes buckets of tags by assigning
+    // random keys, partitioning the input, and padding with dummies.
     void initializeBuckets(const std::vector<std::string>& input_array, int B, int Z);
 
+    // The payload half of step 1: replaces the arena's contents with input_array.
+    void loadPayloads(const std::vector<std::string>& input_array);
+
     // Step 2: Processes the butterfly network by performing MergeSplit on each bucket pair.
-    void performButterflyNetwork(int B, int L, int Z);
+    // The L levels run in passes of fusedLevels(Z, L) levels each, over groups of buckets
+    // that are loaded once per pass; with a single level per pass a group is a bucket pair.
+    // The groups of a pass are independent and are spread across the thread pool; each
+    // pass completes before the next one starts. Pass p reads untrusted level p and writes
+    // level p + 1; returns the level holding the final buckets (L when passes are not
+    // fused). With arrays > 1, that many independent sorts of B buckets each are stored
+    // back to back and processed together, one barrier per pass for all of them.
+    int performButterflyNetwork(int B, int L, int Z, int arrays = 1);
+
+    // Butterfly levels per pass for buckets of Z tags under config.butterfly_group_bytes,
+    // between 1 and L.
+    int fusedLevels(int Z, int L) const;
 
-    // Step 3: Extracts final elements from the last level and performs an oblivious permutation on each bucket.
-    std::vector<Element> extractFinalElements(int B, int L);
+    // Trusted memory each worker of performButterflyNetwork holds: its group of buckets
+    // and the MergeSplit scratch. The network's working set is this times num_threads.
+    size_t butterflyBytesPerThread(int Z, int L) const;
 
-    // Step 4: Performs a final non-oblivious sort on the extracted elements.
-    std::vector<std::string> finalSort(const std::vector<Element>& final_elements);
+    // Sweeps over the data a final sort of n elements makes, ceil(log2 n), for the bytes
+    // it touches.
+    static int sortPasses(size_t n);
+
+    // Step 1 without the payloads: writes level 0 for n elements whose payload indices are
+    // first_payload..first_payload+n-1, with fresh random keys, into buckets
+    // first_bucket..first_bucket+B-1.
+    void writeInitialBuckets(int n, int B, int Z, int first_bucket = 0, uint32_t first_payload = 0);
+
+    // Steps 1 and 2 under config.overflow_policy, for `arrays` sorts laid out as in
+    // performButterflyNetwork: allocates the levels, calls write_level0(Z) to fill level 0
+    // and runs the network. After an overflow, level 0 is written again and the network
+    // restarts from it. Under OverflowPolicy::Grow plan.Z is doubled first, and plan (n
+    // elements per array) is updated to the parameters finally used. Returns the level
+    // holding the final buckets.
+    using Level0Writer = std::function<void(int Z)>;
+    int routeBuckets(int n, BucketParameters& plan, int arrays, const Level0Writer& write_level0);
+
+    // Step 3: Extracts final elements from the last level (the one performButterflyNetwork
+    // returned): each bucket is obliviously permuted and compacted with
+    // config.bucket_shuffle, the buckets spread across the thread pool. Returns the real
+    // tags, bucket after bucket.
+    std::vector<ElementTag> extractFinalElements(int B, int level);
+
+    // Step 3 for buckets first_bucket..first_bucket+count-1, without releasing the level.
+    std::vector<ElementTag> extractFinalRange(int level, int first_bucket, int count);
+
+    // Decrypts final bucket bucket_index into bucket and obliviously permutes it with random
+    // bits from bucket_rng; bucket is left holding just its real tags. Returns the number
+    // of slots of the bucket.
+    size_t extractFinalBucket(int level, int bucket_index, std::vector<ElementTag>& bucket, CounterRng bucket_rng);
+
+    // Step 4: Sorts the extracted tags in place with config.final_sort and materializes
+    // the payloads in that order.
+    std::vector<std::string> finalSort(std::vector<ElementTag> final_elements);
 
     // The main oblivious sort function.
     std::vector<std::string> oblivious_sort(const std::vector<std::string>& input_array, int bucket_size);
 
+    // Typed variant for fixed-size values: integers, FixedBytes<N> and KeyRecord<K>
+    // (value_traits.h). The bucket network is the same; the tags refer to input_array
+    // directly, so no payload arena is built, and the final sort orders the values
+    // themselves with config.final_sort.
+    template <class Value>
+    std::vector<Value> oblivious_sort(const std::vector<Value>& input_array, int bucket_size);
+
+    // Sorts many independent inputs (oblivious_sort on each, same results). Inputs with
+    // equal bucket parameters (B, L) are sorted together in passes of at most
+    // config.batch_slot_budget slots per level: one allocate() of the untrusted arena per
+    // pass, which a backend such as FlatUntrustedMemory serves from the memory it already
+    // holds; one butterfly network for all arrays of the pass, with one barrier per level;
+    // and the final sorts of the arrays spread across the thread pool.
+    std::vector<std::vector<std::string>> oblivious_sort_batch(
+        const std::vector<std::vector<std::string>>& inputs, int bucket_size);
+
+    template <class Value>
+    std::vector<std::vector<Value>> oblivious_sort_batch(
+        const std::vector<std::vector<Value>>& inputs, int bucket_size);
+
+    // Pass structure shared by the batch sorts, for arrays of the given sizes. For each
+    // pass, load(members, first_payload) runs first: members are the arrays of the pass and
+    // first_payload[k] is the payload index given to element 0 of members[k]. After the
+    // network, finish(array, first_payload, tags) receives each array's extracted tags in
+    // oblivious random order; it is called concurrently from the pool's threads.
+    using BatchLoad = std::function<void(const std::vector<size_t>& members, const std::vector<uint32_t>& first_payload)>;
+    using BatchFinish = std::function<void(size_t array, uint32_t first_payload, std::vector<ElementTag>& tags)>;
+    void runBatch(const std::vector<size_t>& sizes, int bucket_size, const BatchLoad& load, const BatchFinish& finish);
+
+    // Streaming variant for inputs larger than memory. Values are read from input and
+    // spooled to a scratch file, the levels live in the untrusted storage (pass a
+    // MappedUntrustedMemory to keep them on disk), and the final sort is an external merge
+    // sort whose output goes to the sink. The spool and the runs are sealed with the
+    // bucket cipher. Trusted memory stays around options.run_bytes.
+    void oblivious_sort_stream(StringSource& input, StringSink& output, int bucket_size,
+                               const StreamingOptions& options = StreamingOptions());
+
     // Bitonic sort based functions for constant storage MergeSplit.
-    void bitonicMerge(std::vector<Element>& a, int low, int cnt, bool ascending);
-    void bitonicSort(std::vector<Element>& a, int low, int cnt, bool ascending);
+    // Both run the iterative, cache-blocked network from bitonic_network.h, and no
+    // compare-exchange branches on the data. Elements whose value fits in a word beside
+    // the key (packsInWord) travel through the branchless SIMD kernel as (key, rest) word
+    // pairs (compare_exchange.h); others through bitonic::BlendKernel.
+    // bitonicSort accepts any cnt; bitonicMerge expects a bitonic range of power-of-two length.
+    // Each typed call is a phase of its own (bitonicSort or bitonicMerge in phases and
+    // trusted_memory), so it must not be made inside another phase.
+    template <class Value>
+    void bitonicMerge(std::vector<BasicElement<Value>>& a, int low, int cnt, bool ascending);
+    template <class Value>
+    void bitonicSort(std::vector<BasicElement<Value>>& a, int low, int cnt, bool ascending);
+    void bitonicSort(std::vector<ElementTag>& a, int low, int cnt, bool ascending);
+
+    // Oblivious selection by key with bitonic::selectNetwork, moving the records as
+    // bitonicSort does: O(cnt log^2 k) compare-exchanges instead of O(cnt log^2 cnt).
+    // bitonicTopK moves the k elements of a[low, low + cnt) that come first in the given
+    // order to a[low, low + k), sorted, and leaves the others after them in no particular
+    // order. bitonicRankRange puts the elements of ascending ranks [first, last) in place at
+    // a[low + first, low + last) with a top-`last` selection. bitonicSelect returns the
+    // element of the given rank (cnt / 2 for the median), selecting from whichever end of
+    // the order is nearer; the rank is in a[low + rank] only if it is in the lower half.
+    template <class Value>
+    void bitonicTopK(std::vector<BasicElement<Value>>& a, int low, int cnt, int k, bool ascending);
+    template <class Value>
+    void bitonicRankRange(std::vector<BasicElement<Value>>& a, int low, int cnt, int first, int last);
+    template <class Value>
+    BasicElement<Value> bitonicSelect(std::vector<BasicElement<Value>>& a, int low, int cnt, int rank);
 
     // Modified MergeSplit function that uses bitonic sort to implement the bucket split
     // with only O(1) enclave storage.
-    std::pair<std::vector<Element>, std::vector<Element>> merge_split_bitonic(
-        const std::vector<Element>& bucket1,
-        const std::vector<Element>& bucket2,
+    std::pair<std::vector<ElementTag>, std::vector<ElementTag>> merge_split_bitonic(
+        const std::vector<ElementTag>& bucket1,
+        const std::vector<ElementTag>& bucket2,
         int level, int total_levels, int Z);
 
+    // In-place MergeSplit on the 2Z tags of a bucket pair with config.merge_split: afterwards
+    // combined[0, Z) is output bucket 0 and combined[Z, 2Z) is output bucket 1.
+    void mergeSplitInPlace(std::vector<ElementTag>& combined, int level, int total_levels, int Z);
+
     // NEW: Oblivious permutation for a bucket using constant local storage.
     // It assigns a random label to each element and then obliviously sorts the bucket.
-    void obliviousPermuteBucket(std::vector<Element>& bucket);
+    void obliviousPermuteBucket(std::vector<ElementTag>& bucket);
 };
 
+// Records that fit in two words: the key word is packKeyIndex(key, position) and the
+// rest word holds every other field. The network then moves the records themselves,
+// with the same masks as the keys, and they are written back in order: no record is
+// ever read or written at a position that depends on the data.
+template <class Value>
+constexpr bool packsInWord = std::is_trivially_copyable_v<Value> && sizeof(Value) < sizeof(uint64_t);
+
+template <class Value>
+uint64_t packRest(const BasicElement<Value>& e) {
+    uint64_t word = 0;
+    std::memcpy(&word, &e.value, sizeof(Value));
+    return word | uint64_t(e.is_dummy) << 63;
+}
+
+template <class Value>
+void unpackRest(uint64_t word, BasicElement<Value>& e) {
+    std::memcpy(&e.value, &word, sizeof(Value));
+    e.is_dummy = (word >> 63) != 0;
+}
+
+inline uint64_t packRest(const ElementTag& t) {
+    return uint64_t(t.payload) | uint64_t(t.is_dummy) << 32;
+}
+
+inline void unpackRest(uint64_t word, ElementTag& t) {
+    t.payload = static_cast<uint32_t>(word);
+    t.is_dummy = static_cast<uint32_t>(word >> 32);
+}
+
+// Packs a[low, low + cnt). With `positions`, equal keys are ordered by position, so a
+// sort is stable; a bitonic merge needs the keys alone, or ties could break bitonicity.
+template <class Record>
+void packRecords(const std::vector<Record>& a, int low, int cnt, bool positions,
+                 std::vector<uint64_t>& keys, std::vector<uint64_t>& rest) {
+    keys.resize(cnt);
+    rest.resize(cnt);
+    for (int i = 0; i < cnt; i++) {
+        keys[i] = cmpex::packKeyIndex(a[low + i].key, positions ? static_cast<uint32_t>(i) : 0);
+        rest[i] = packRest(a[low + i]);
+    }
+}
+
+template <class Record>
+void unpackRecords(const std::vector<uint64_t>& keys, const std::vector<uint64_t>& rest,
+                   std::vector<Record>& a, int low) {
+    for (size_t i = 0; i < keys.size(); i++) {
+        a[low + i].key = cmpex::packedKey(keys[i]);
+        unpackRest(rest[i], a[low + i]);
+    }
+}
+
+template <class Record>
+void sortByPackedKey(std::vector<Record>& a, int low, int cnt, bool ascending) {
+    std::vector<uint64_t> keys, rest;
+    packRecords(a, low, cnt, true, keys, rest);
+    cmpex::sortKeyValue(keys.data(), rest.data(), keys.size(), ascending);
+    unpackRecords(keys, rest, a, low);
+}
+
+template <class Record>
+void mergeByPackedKey(std::vector<Record>& a, int low, int cnt, bool ascending) {
+    std::vector<uint64_t> keys, rest;
+    packRecords(a, low, cnt, false, keys, rest);
+    cmpex::mergeKeyValue(keys.data(), rest.data(), keys.size(), ascending);
+    unpackRecords(keys, rest, a, low);
+}
+
+template <class Value>
+auto keyOrder(bool ascending) {
+    return [ascending](const BasicElement<Value>& x, const BasicElement<Value>& y) {
+        return ascending ? x.key < y.key : x.key > y.key;
+    };
+}
+
+// As sortByPackedKey, but only the first k records by key are sorted into a[low, low + k);
+// the others follow them. The records travel through the selection network themselves,
+// which is the same for every input of this (cnt, k).
+template <class Record>
+void selectByPackedKey(std::vector<Record>& a, int low, int cnt, int k, bool ascending) {
+    std::vector<uint64_t> keys, rest;
+    packRecords(a, low, cnt, true, keys, rest);
+    cmpex::selectKeyValue(keys.data(), rest.data(), keys.size(), static_cast<size_t>(k), ascending);
+    unpackRecords(keys, rest, a, low);
+}
+
+// Trusted bytes a typed bitonic call works on: the range, plus its (key, rest) words if
+// it packs.
+template <class Value>
+size_t bitonicBytes(int cnt) {
+    return static_cast<size_t>(cnt) * (sizeof(BasicElement<Value>) + (packsInWord<Value> ? 2 * sizeof(uint64_t) : 0));
+}
+
+template <class Value>
+void Enclave::bitonicMerge(std::vector<BasicElement<Value>>& a, int low, int cnt, bool ascending) {
+    if (cnt <= 1)
+        return;
+    if ((cnt & (cnt - 1)) != 0)
+        throw std::invalid_argument("bitonicMerge requires a power-of-two length.");
+    SortPhase phase(*this, "bitonicMerge");
+    size_t bytes = bitonicBytes<Value>(cnt);
+    TrustedMemory::Charge held = trusted_memory.charge(bytes);
+    trusted_memory.touch(bytes * sortPasses(cnt));
+    if constexpr (packsInWord<Value>) {
+        mergeByPackedKey(a, low, cnt, ascending);
+    }
+    else {
+        auto order = keyOrder<Value>(ascending);
+        bitonic::BlendKernel<typename std::vector<BasicElement<Value>>::iterator, decltype(order)> kernel{
+            a.begin() + low, order };
+        bitonic::mergeNetwork(cnt, kernel, bitonic::defaultTile<BasicElement<Value>>());
+    }
+}
+
+template <class Value>
+void Enclave::bitonicSort(std::vector<BasicElement<Value>>& a, int low, int cnt, bool ascending) {
+    if (cnt <= 1)
+        return;
+    SortPhase phase(*this, "bitonicSort");
+    size_t bytes = bitonicBytes<Value>(cnt);
+    TrustedMemory::Charge held = trusted_memory.charge(bytes);
+    trusted_memory.touch(bytes * sortPasses(cnt));
+    if constexpr (packsInWord<Value>) {
+        sortByPackedKey(a, low, cnt, ascending);
+    }
+    else {
+        auto order = keyOrder<Value>(ascending);
+        bitonic::BlendKernel<typename std::vector<BasicElement<Value>>::iterator, decltype(order)> kernel{
+            a.begin() + low, order };
+        bitonic::sortNetwork(cnt, kernel, bitonic::defaultTile<BasicElement<Value>>());
+    }
+}
+
+template <class Value>
+void Enclave::bitonicTopK(std::vector<BasicElement<Value>>& a, int low, int cnt, int k, bool ascending) {
+    if (k < 0 || k > cnt)
+        throw std::invalid_argument("Top-k count outside the range.");
+    if (cnt <= 1 || k == 0)
+        return;
+    if constexpr (packsInWord<Value>) {
+        selectByPackedKey(a, low, cnt, k, ascending);
+    }
+    else {
+        auto order = keyOrder<Value>(ascending);
+        bitonic::BlendKernel<typename std::vector<BasicElement<Value>>::iterator, decltype(order)> kernel{
+            a.begin() + low, order };
+        bitonic::selectNetwork(cnt, k, kernel, bitonic::defaultTile<BasicElement<Value>>());
+    }
+}
+
+template <class Value>
+void Enclave::bitonicRankRange(std::vector<BasicElement<Value>>& a, int low, int cnt, int first, int last) {
+    if (first < 0 || first > last || last > cnt)
+        throw std::invalid_argument("Rank range outside the range.");
+    bitonicTopK(a, low, cnt, last, true);
+}
+
+template <class Value>
+BasicElement<Value> Enclave::bitonicSelect(std::vector<BasicElement<Value>>& a, int low, int cnt, int rank) {
+    if (rank < 0 || rank >= cnt)
+        throw std::out_of_range("Rank outside the range.");
+    if (cnt - rank < rank + 1) {
+        bitonicTopK(a, low, cnt, cnt - rank, false);
+        return a[low + cnt - rank - 1];
+    }
+    bitonicTopK(a, low, cnt, rank + 1, true);
+    return a[low + rank];
+}
+
+template <class Value>
+std::vector<Value> Enclave::oblivious_sort(const std::vector<Value>& input_array, int bucket_size) {
+    if (input_array.size() > static_cast<size_t>(std::numeric_limits<int>::max()))
+        throw std::overflow_error("Input too large for the bucket parameters.");
+    int n = static_cast<int>(input_array.size());
+    BucketParameters plan = planBuckets(n, bucket_size);
+    int final_level = routeBuckets(n, plan, 1, [&](int Z) { writeInitialBuckets(n, plan.B, Z); });
+    std::vector<ElementTag> final_elements;
+    {
+        SortPhase phase(*this, "extractFinalElements");
+        final_elements = extractFinalElements(plan.B, final_level);
+    }
+    TrustedMemory::Charge tag_memory = trusted_memory.charge(final_elements.size() * sizeof(ElementTag));
+    SortPhase phase(*this, "finalSort");
+    // The extracted tags are in an oblivious random order; reading the values in that
+    // order reveals nothing about them.
+    size_t value_bytes = final_elements.size() * sizeof(Value);
+    TrustedMemory::Charge output_memory = trusted_memory.charge(value_bytes);
+    trusted_memory.touch(value_bytes * sortPasses(final_elements.size()));
+    std::vector<Value> sorted_values;
+    sorted_values.reserve(final_elements.size());
+    for (const auto& elem : final_elements)
+        sorted_values.push_back(input_array[elem.payload]);
+    sortValues(sorted_values, config.final_sort, pool.get());
+    return sorted_values;
+}
+
+template <class Value>
+std::vector<std::vector<Value>> Enclave::oblivious_sort_batch(
+    const std::vector<std::vector<Value>>& inputs, int bucket_size) {
+    std::vector<size_t> sizes(inputs.size());
+    for (size_t a = 0; a < inputs.size(); a++)
+        sizes[a] = inputs[a].size();
+    std::vector<std::vector<Value>> outputs(inputs.size());
+    runBatch(sizes, bucket_size,
+        [](const std::vector<size_t>&, const std::vector<uint32_t>&) {},
+        [&](size_t array, uint32_t first_payload, std::vector<ElementTag>& tags) {
+            std::vector<Value>& out = outputs[array];
+            out.reserve(tags.size());
+            for (const auto& elem : tags)
+                out.push_back(inputs[array][elem.payload - first_payload]);
+            // Each array is sorted by one thread; the pool is busy with the other arrays.
+            sortValues(out, config.final_sort, nullptr);
+        });
+    return outputs;
+}
+
 #endif // OBLIVIOUS_SORT_H
\ No newline at end of file
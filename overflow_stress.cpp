@@ -0,0 +1,66 @@
+// overflow_stress.cpp (Stress test: empirical bucket overflow probability against Z)
+// Usage: overflow_stress [n = 4096] [min_Z = 20] [max_Z = 48] [trials = 200] [num_threads = 1]
+//                        [seed = 42]
+// For each Z from min_Z to max_Z (step 4), sorts `trials` random inputs of n integers with
+// OverflowPolicy::Reseed, so a network that overflows is restarted with fresh keys rather
+// than failing. Reports the fraction of networks that overflowed next to the union bound
+// of overflowProbability, the restarts needed, and checks that every output is sorted.
+// The inputs and the enclave's random keys all derive from the seed, so a run repeats
+// exactly, whatever the thread count.
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+#include "oblivious_sort.h"
+
+int main(int argc, char** argv) {
+    int n = argc > 1 ? std::stoi(argv[1]) : 4096;
+    int min_Z = argc > 2 ? std::stoi(argv[2]) : 20;
+    int max_Z = argc > 3 ? std::stoi(argv[3]) : 48;
+    int trials = argc > 4 ? std::stoi(argv[4]) : 200;
+    int threads = argc > 5 ? std::stoi(argv[5]) : 1;
+    uint64_t seed = argc > 6 ? std::stoull(argv[6]) : 42;
+
+    std::mt19937 gen(static_cast<uint32_t>(seed));
+    std::vector<uint32_t> input(n);
+    bool all_sorted = true;
+    std::cout << "Z,B,networks,overflows,empirical_rate,bound,reseeds,failures\n";
+    for (int Z = min_Z; Z <= max_Z; Z += 4) {
+        FlatUntrustedMemory untrusted;
+        EnclaveConfig config;
+        config.num_threads = threads;
+        config.seed = seed + Z;
+        config.overflow_policy = OverflowPolicy::Reseed;
+        // Enough restarts that small Z still finishes; the rate is per network either way.
+        config.max_overflow_retries = 100;
+        Enclave enclave(&untrusted, config);
+        int B = 0;
+        try {
+            B = enclave.computeBucketParameters(n, Z).first;
+        }
+        catch (const std::invalid_argument&) {
+            continue;  // Z too small to hold n elements at all.
+        }
+
+        for (int t = 0; t < trials; t++) {
+            for (auto& v : input)
+                v = gen();
+            try {
+                std::vector<uint32_t> sorted = enclave.oblivious_sort(input, Z);
+                all_sorted = all_sorted && sorted.size() == input.size() && std::is_sorted(sorted.begin(), sorted.end());
+            }
+            catch (const std::overflow_error&) {
+                // Counted in overflow_stats.failures.
+            }
+        }
+        const OverflowStats& stats = enclave.overflow_stats;
+        std::cout << Z << "," << B << "," << stats.networks << "," << stats.overflows << ","
+                  << std::scientific << std::setprecision(3) << stats.overflowRate() << ","
+                  << std::min(1.0, overflowProbability(n, B, Z)) << std::defaultfloat << ","
+                  << stats.reseeds << "," << stats.failures << std::endl;
+    }
+    std::cout << "All outputs sorted? " << (all_sorted ? "Yes" : "No") << "\n";
+    return all_sorted ? 0 : 1;
+}
@@ -0,0 +1,224 @@
+#include "partition_transport.h"
+#include <stdexcept>
+#include <algorithm>
+#include <string>
+#include <cstring>
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+static std::runtime_error systemError(const char* what) {
+    return std::runtime_error(std::string(what) + ": " + std::strerror(errno));
+}
+
+// Receive buffer: a whole number of tags, about 64 KiB.
+static const size_t kChunkTags = (64 * 1024) / sizeof(ElementTag);
+
+const char* transportKindName(TransportKind kind) {
+    switch (kind) {
+    case TransportKind::UnixSocket: return "unix-socket";
+    default: return "in-process";
+    }
+}
+
+// ----- InProcessTransport Methods -----
+InProcessTransport::InProcessTransport(int num_enclaves) : num_enclaves(num_enclaves) {
+    for (int i = 0; i < num_enclaves * num_enclaves; i++)
+        mailboxes.push_back(std::make_unique<Mailbox>());
+}
+
+void InProcessTransport::send(int from, int to, const ElementTag* data, size_t count) {
+    Mailbox& box = *mailboxes[from * num_enclaves + to];
+    {
+        std::lock_guard<std::mutex> lock(box.mutex);
+        if (box.data)
+            throw std::logic_error("Previous partition on this link was not received.");
+        box.data = data;
+        box.count = count;
+    }
+    box.ready.notify_one();
+    bytes_sent.fetch_add(count * sizeof(ElementTag), std::memory_order_relaxed);
+}
+
+void InProcessTransport::receive(int to, int from, size_t count, const ChunkConsumer& consume) {
+    Mailbox& box = *mailboxes[from * num_enclaves + to];
+    const ElementTag* data;
+    {
+        std::unique_lock<std::mutex> lock(box.mutex);
+        box.ready.wait(lock, [&box] { return box.data != nullptr; });
+        if (box.count != count)
+            throw std::logic_error("Received partition has an unexpected length.");
+        data = box.data;
+        box.data = nullptr;
+    }
+    consume(0, data, count);
+}
+
+// ----- UnixSocketTransport Methods -----
+UnixSocketTransport::UnixSocketTransport(int num_enclaves, const std::vector<std::pair<int, int>>& links)
+    : num_enclaves(num_enclaves), fds(static_cast<size_t>(num_enclaves) * num_enclaves, -1), writers(num_enclaves) {
+    // Two descriptors per link; lift the soft limit if the schedule needs more.
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        rlim_t needed = 2 * links.size() + 64;
+        if (limit.rlim_cur < needed) {
+            limit.rlim_cur = std::min(limit.rlim_max, needed);
+            setrlimit(RLIMIT_NOFILE, &limit);
+        }
+    }
+    for (const auto& link : links) {
+        if (endpoint(link.first, link.second) >= 0)
+            continue;
+        int pair[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0)
+            throw systemError("Cannot create enclave link");
+        fds[link.first * num_enclaves + link.second] = pair[0];
+        fds[link.second * num_enclaves + link.first] = pair[1];
+    }
+}
+
+UnixSocketTransport::~UnixSocketTransport() {
+    for (auto& w : writers) {
+        if (!w)
+            continue;
+        {
+            std::lock_guard<std::mutex> lock(w->mutex);
+            w->stopping = true;
+        }
+        w->changed.notify_all();
+        w->thread.join();
+    }
+    for (int fd : fds)
+        if (fd >= 0)
+            close(fd);
+}
+
+int UnixSocketTransport::endpoint(int self, int peer) const {
+    return fds[self * num_enclaves + peer];
+}
+
+UnixSocketTransport::Writer& UnixSocketTransport::writer(int from) {
+    std::lock_guard<std::mutex> lock(writers_mutex);
+    if (!writers[from]) {
+        writers[from] = std::make_unique<Writer>();
+        Writer& w = *writers[from];
+        w.thread = std::thread([this, &w] { writerLoop(w); });
+    }
+    return *writers[from];
+}
+
+void UnixSocketTransport::writerLoop(Writer& w) {
+    std::unique_lock<std::mutex> lock(w.mutex);
+    for (;;) {
+        w.changed.wait(lock, [&w] { return w.stopping || !w.jobs.empty(); });
+        if (w.jobs.empty())
+            return;
+        auto job = w.jobs.front();
+        w.jobs.pop_front();
+        w.busy = true;
+        lock.unlock();
+
+        const char* bytes = reinterpret_cast<const char*>(job.second.first);
+        size_t left = job.second.second * sizeof(ElementTag);
+        try {
+            while (left > 0) {
+                ssize_t written = ::send(job.first, bytes, left, MSG_NOSIGNAL);
+                if (written < 0) {
+                    if (errno == EINTR)
+                        continue;
+                    throw systemError("Cannot send partition");
+                }
+                bytes += written;
+                left -= static_cast<size_t>(written);
+            }
+        }
+        catch (...) {
+            lock.lock();
+            w.error = std::current_exception();
+            w.busy = false;
+            w.changed.notify_all();
+            continue;
+        }
+
+        lock.lock();
+        w.busy = false;
+        w.changed.notify_all();
+    }
+}
+
+void UnixSocketTransport::send(int from, int to, const ElementTag* data, size_t count) {
+    int fd = endpoint(from, to);
+    if (fd < 0)
+        throw std::invalid_argument("No link between these enclaves.");
+    Writer& w = writer(from);
+    {
+        std::lock_guard<std::mutex> lock(w.mutex);
+        w.jobs.push_back({ fd, { data, count } });
+    }
+    w.changed.notify_all();
+    bytes_sent.fetch_add(count * sizeof(ElementTag), std::memory_order_relaxed);
+}
+
+void UnixSocketTransport::waitSends(int from) {
+    Writer& w = writer(from);
+    std::unique_lock<std::mutex> lock(w.mutex);
+    w.changed.wait(lock, [&w] { return w.jobs.empty() && !w.busy; });
+    if (w.error) {
+        std::exception_ptr error = w.error;
+        w.error = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void UnixSocketTransport::restrictTo(int self) {
+    for (int owner = 0; owner < num_enclaves; owner++) {
+        if (owner == self)
+            continue;
+        for (int peer = 0; peer < num_enclaves; peer++) {
+            int& fd = fds[owner * num_enclaves + peer];
+            if (fd >= 0) {
+                close(fd);
+                fd = -1;
+            }
+        }
+    }
+}
+
+void UnixSocketTransport::receive(int to, int from, size_t count, const ChunkConsumer& consume) {
+    int fd = endpoint(to, from);
+    if (fd < 0)
+        throw std::invalid_argument("No link between these enclaves.");
+    std::vector<ElementTag> buffer(std::min(count, kChunkTags));
+    char* base = reinterpret_cast<char*>(buffer.data());
+    size_t offset = 0;    // Tags already passed to consume.
+    size_t pending = 0;   // Bytes in the buffer not yet consumed.
+    while (offset < count) {
+        size_t want = std::min(buffer.size(), count - offset) * sizeof(ElementTag) - pending;
+        ssize_t got = recv(fd, base + pending, want, 0);
+        if (got < 0) {
+            if (errno == EINTR)
+                continue;
+            throw systemError("Cannot receive partition");
+        }
+        if (got == 0)
+            throw std::runtime_error("Enclave link closed during a transfer.");
+        pending += static_cast<size_t>(got);
+        size_t whole = pending / sizeof(ElementTag);
+        if (whole == 0)
+            continue;
+        consume(offset, buffer.data(), whole);
+        offset += whole;
+        // Keep a partial tag at the front of the buffer.
+        size_t rest = pending - whole * sizeof(ElementTag);
+        std::memmove(base, base + whole * sizeof(ElementTag), rest);
+        pending = rest;
+    }
+}
+
+std::unique_ptr<PartitionTransport> makePartitionTransport(TransportKind kind, int num_enclaves,
+                                                           const std::vector<std::pair<int, int>>& links) {
+    if (kind == TransportKind::UnixSocket)
+        return std::make_unique<UnixSocketTransport>(num_enclaves, links);
+    return std::make_unique<InProcessTransport>(num_enclaves);
+}
@@ -0,0 +1,120 @@
+#ifndef PARTITION_TRANSPORT_H
+#define PARTITION_TRANSPORT_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include "element_store.h"
+
+enum class TransportKind {
+    InProcess,  // Zero-copy: the receiver reads the sender's buffer directly.
+    UnixSocket  // One Unix domain socket per pair of partners; works across processes.
+};
+
+const char* transportKindName(TransportKind kind);
+
+// Moves partitions between simulated enclaves. Sends are asynchronous, so every enclave
+// of a round can post its partition before any of them blocks in receive(). Receivers
+// consume a partition chunk by chunk as it arrives, which lets the merge work on the
+// first chunks while the rest is still in flight.
+class PartitionTransport {
+public:
+    // Called with consecutive chunks [offset, offset + count) of the message.
+    using ChunkConsumer = std::function<void(size_t offset, const ElementTag* chunk, size_t count)>;
+
+    virtual ~PartitionTransport() = default;
+
+    virtual const char* name() const = 0;
+
+    // Starts sending data[0, count) from enclave `from` to enclave `to` and returns at once.
+    // data must stay unchanged until waitSends(from) has returned.
+    virtual void send(int from, int to, const ElementTag* data, size_t count) = 0;
+
+    // Receives the count tags that `from` sent to `to`.
+    virtual void receive(int to, int from, size_t count, const ChunkConsumer& consume) = 0;
+
+    // Blocks until every send started by enclave `from` has been handed off.
+    virtual void waitSends(int from) = 0;
+
+    // For a process that hosts only enclave `self` (or none, for -1): releases what the
+    // other enclaves' ends hold, so that a peer process exiting closes its links.
+    virtual void restrictTo(int /*self*/) {}
+
+    // Bytes sent through this transport object (in this process).
+    uint64_t bytesSent() const { return bytes_sent.load(std::memory_order_relaxed); }
+
+protected:
+    std::atomic<uint64_t> bytes_sent{ 0 };
+};
+
+// All enclaves in one address space. A send publishes a pointer to the sender's buffer;
+// the receiver reads it in place, as one chunk.
+class InProcessTransport : public PartitionTransport {
+public:
+    explicit InProcessTransport(int num_enclaves);
+
+    const char* name() const override { return "in-process"; }
+    void send(int from, int to, const ElementTag* data, size_t count) override;
+    void receive(int to, int from, size_t count, const ChunkConsumer& consume) override;
+    void waitSends(int /*from*/) override {}
+
+private:
+    struct Mailbox {
+        std::mutex mutex;
+        std::condition_variable ready;
+        const ElementTag* data = nullptr;
+        size_t count = 0;
+    };
+
+    int num_enclaves;
+    std::vector<std::unique_ptr<Mailbox>> mailboxes;  // Indexed by from * num_enclaves + to.
+};
+
+// A connected pair of Unix domain sockets for every link, created up front so that the
+// endpoints survive fork(): each enclave may then run in its own process. Each enclave
+// sends from its own writer thread, started on first use, so a full socket buffer never
+// blocks the caller.
+class UnixSocketTransport : public PartitionTransport {
+public:
+    UnixSocketTransport(int num_enclaves, const std::vector<std::pair<int, int>>& links);
+    ~UnixSocketTransport() override;
+
+    const char* name() const override { return "unix-socket"; }
+    void send(int from, int to, const ElementTag* data, size_t count) override;
+    void receive(int to, int from, size_t count, const ChunkConsumer& consume) override;
+    void waitSends(int from) override;
+    void restrictTo(int self) override;
+
+private:
+    struct Writer {
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::deque<std::pair<int, std::pair<const ElementTag*, size_t>>> jobs;  // (fd, (data, count))
+        bool busy = false;
+        bool stopping = false;
+        std::exception_ptr error;
+    };
+
+    int endpoint(int self, int peer) const;
+    Writer& writer(int from);
+    void writerLoop(Writer& w);
+
+    int num_enclaves;
+    std::vector<int> fds;  // fds[self * num_enclaves + peer]: self's end of the link, or -1.
+    std::mutex writers_mutex;
+    std::vector<std::unique_ptr<Writer>> writers;
+};
+
+std::unique_ptr<PartitionTransport> makePartitionTransport(TransportKind kind, int num_enclaves,
+                                                           const std::vector<std::pair<int, int>>& links);
+
+#endif // PARTITION_TRANSPORT_H
@@ -0,0 +1,353 @@
+// sort_bench.cpp (Benchmark: std::sort, bitonic, oblivious bucket and distributed sorts on one input)
+// Usage: sort_bench [n = 1048576] [input = int | string | all]
+//                   [distribution = uniform | sorted | reversed | few_unique] [format = csv | json]
+//                   [bucket_size = 256] [num_enclaves = 8] [num_threads = hardware threads] [repeats = 1]
+//                   [seed = random]
+// Generates the input, runs every sort on a fresh copy of it and prints one row per sort:
+// wall time (best of the repeats), throughput, peak RSS and the bytes the sort moved out
+// of the enclave. For the oblivious bucket sort that is the bucket traffic to untrusted
+// memory; for the distributed sort it is the partition traffic between enclaves.
+//
+// With a seed, the oblivious bucket sort draws all of its randomness from it, so its
+// bucket keys and permutations, and hence its overflows and timing, repeat across runs.
+//
+// The distributed sort takes strings, so integer inputs are handed to it as fixed-width
+// keys that sort in the same order as the integers.
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <numeric>
+#include <algorithm>
+#include <functional>
+#include <cstdint>
+#include <cstdio>
+#include <optional>
+#include "oblivious_sort.h"
+#include "distributed_sort.h"
+
+enum class Distribution { Uniform, Sorted, Reversed, FewUnique };
+
+static Distribution parseDistribution(const std::string& name) {
+    if (name == "uniform") return Distribution::Uniform;
+    if (name == "sorted") return Distribution::Sorted;
+    if (name == "reversed") return Distribution::Reversed;
+    if (name == "few_unique") return Distribution::FewUnique;
+    throw std::invalid_argument("Unknown distribution " + name);
+}
+
+// Applies the distribution to uniformly drawn values.
+template <class T>
+static void shape(std::vector<T>& values, Distribution dist, std::mt19937& gen) {
+    switch (dist) {
+    case Distribution::Uniform:
+        break;
+    case Distribution::Sorted:
+        std::sort(values.begin(), values.end());
+        break;
+    case Distribution::Reversed:
+        std::sort(values.begin(), values.end(), std::greater<T>());
+        break;
+    case Distribution::FewUnique: {
+        // About 16 distinct values, each repeated many times.
+        std::vector<T> pool(values.begin(), values.begin() + std::min<size_t>(16, values.size()));
+        std::uniform_int_distribution<size_t> pick(0, pool.empty() ? 0 : pool.size() - 1);
+        for (auto& v : values)
+            v = pool[pick(gen)];
+        break;
+    }
+    }
+}
+
+static std::vector<int> makeInts(size_t n, Distribution dist, uint32_t seed) {
+    std::mt19937 gen(seed);
+    std::vector<int> values(n);
+    for (auto& v : values)
+        v = static_cast<int>(gen());
+    shape(values, dist, gen);
+    return values;
+}
+
+static std::vector<std::string> makeStrings(size_t n, Distribution dist, uint32_t seed) {
+    static const char alphabet[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<int> length(4, 16);
+    std::uniform_int_distribution<int> letter(0, sizeof(alphabet) - 2);
+    std::vector<std::string> values(n);
+    for (auto& v : values) {
+        v.resize(length(gen));
+        for (auto& c : v)
+            c = alphabet[letter(gen)];
+    }
+    shape(values, dist, gen);
+    return values;
+}
+
+// Ten decimal digits of the value with its sign bit flipped: string order equals int order.
+static std::vector<std::string> orderedKeys(const std::vector<int>& values) {
+    std::vector<std::string> keys(values.size());
+    char digits[16];
+    for (size_t i = 0; i < values.size(); i++) {
+        std::snprintf(digits, sizeof(digits), "%010u", static_cast<uint32_t>(values[i]) ^ 0x80000000u);
+        keys[i] = digits;
+    }
+    return keys;
+}
+
+// Peak resident set size of the process, in KiB (VmHWM). resetPeakRss() restarts it from
+// the current RSS where the kernel allows it, so each sort reports its own peak.
+static size_t readStatusKiB(const char* field) {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    size_t len = std::char_traits<char>::length(field);
+    while (std::getline(status, line))
+        if (line.compare(0, len, field) == 0)
+            return std::stoul(line.substr(len + 1));
+    return 0;
+}
+
+static void resetPeakRss() {
+    std::ofstream clear("/proc/self/clear_refs");
+    clear << "5";
+}
+
+struct BenchResult {
+    std::string algorithm;
+    std::string input;
+    size_t n = 0;
+    double wall_ms = 0;
+    size_t peak_rss_kib = 0;
+    size_t rss_before_kib = 0;
+    uint64_t moved_bytes = 0;
+    bool sorted = false;
+};
+
+struct BenchOptions {
+    size_t n = size_t(1) << 20;
+    Distribution distribution = Distribution::Uniform;
+    int bucket_size = 256;
+    int num_enclaves = 8;
+    int num_threads = 1;
+    int repeats = 1;
+    std::optional<uint64_t> seed;
+};
+
+// One run of a sort: prepares its own copy of the input (untimed), then sorts it (timed)
+// and reports the bytes moved and whether the output is sorted.
+struct Trial {
+    std::function<void()> prepare;
+    std::function<void()> run;
+    std::function<uint64_t()> movedBytes;
+    std::function<bool()> verify;
+};
+
+static BenchResult measure(const std::string& algorithm, const std::string& input, size_t n,
+                           const BenchOptions& options, Trial trial) {
+    BenchResult result;
+    result.algorithm = algorithm;
+    result.input = input;
+    result.n = n;
+    result.sorted = true;
+    for (int r = 0; r < options.repeats; r++) {
+        trial.prepare();
+        resetPeakRss();
+        size_t before = readStatusKiB("VmRSS:");
+        auto start = std::chrono::steady_clock::now();
+        trial.run();
+        auto stop = std::chrono::steady_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(stop - start).count();
+        size_t peak = readStatusKiB("VmHWM:");
+        if (r == 0 || ms < result.wall_ms) {
+            result.wall_ms = ms;
+            result.moved_bytes = trial.movedBytes();
+        }
+        result.peak_rss_kib = std::max(result.peak_rss_kib, peak);
+        result.rss_before_kib = r == 0 ? before : std::min(result.rss_before_kib, before);
+        result.sorted = result.sorted && trial.verify();
+    }
+    return result;
+}
+
+static EnclaveConfig enclaveConfig(const BenchOptions& options) {
+    EnclaveConfig config;
+    config.num_threads = options.num_threads;
+    config.seed = options.seed;
+    return config;
+}
+
+static DistributedSortConfig distributedConfig(const BenchOptions& options) {
+    DistributedSortConfig config;
+    config.num_enclaves = options.num_enclaves;
+    config.num_threads = options.num_threads;
+    return config;
+}
+
+// oblivious_sort on strings or, through the typed overload, on integers.
+template <class Value>
+static void benchOblivious(const std::string& input, const std::vector<Value>& values,
+                           const BenchOptions& options, std::vector<BenchResult>& results) {
+    std::vector<Value> out;
+    FlatUntrustedMemory flat;
+    CountingUntrustedStorage untrusted(&flat);
+    results.push_back(measure("oblivious_sort", input, values.size(), options, Trial{
+        [&] { out.clear(); untrusted.resetCounters(); },
+        [&] {
+            Enclave enclave(&untrusted, enclaveConfig(options));
+            out = enclave.oblivious_sort(values, options.bucket_size);
+        },
+        [&] { return untrusted.bytesRead() + untrusted.bytesWritten(); },
+        [&] { return out.size() == values.size() && std::is_sorted(out.begin(), out.end()); } }));
+}
+
+static void benchDistributed(const std::string& input, const std::vector<std::string>& values,
+                             const BenchOptions& options, std::vector<BenchResult>& results) {
+    std::vector<std::string> out;
+    DistributedSorter sorter(distributedConfig(options));
+    results.push_back(measure("distributed_bitonic", input, values.size(), options, Trial{
+        [&] { out.clear(); },
+        [&] { out = sorter.sort(values); },
+        [&] {
+            const auto& bytes = sorter.stats().round_bytes;
+            return std::accumulate(bytes.begin(), bytes.end(), uint64_t(0));
+        },
+        [&] { return out.size() == values.size() && std::is_sorted(out.begin(), out.end()); } }));
+}
+
+static void benchInts(const BenchOptions& options, std::vector<BenchResult>& results) {
+    const std::vector<int> values = makeInts(options.n, options.distribution, 1);
+    std::vector<int> copy;
+    results.push_back(measure("std::sort", "int", values.size(), options, Trial{
+        [&] { copy = values; },
+        [&] { std::sort(copy.begin(), copy.end()); },
+        [] { return uint64_t(0); },
+        [&] { return std::is_sorted(copy.begin(), copy.end()); } }));
+    copy = std::vector<int>();
+
+    std::vector<BasicElement<int>> elements;
+    UntrustedMemory unused;
+    Enclave enclave(&unused);
+    results.push_back(measure("bitonicSort", "int", values.size(), options, Trial{
+        [&] {
+            elements.resize(values.size());
+            for (size_t i = 0; i < values.size(); i++)
+                elements[i] = BasicElement<int>{ values[i], values[i], false };
+        },
+        [&] { enclave.bitonicSort(elements, 0, static_cast<int>(elements.size()), true); },
+        [] { return uint64_t(0); },
+        [&] {
+            return std::is_sorted(elements.begin(), elements.end(),
+                [](const BasicElement<int>& a, const BasicElement<int>& b) { return a.key < b.key; });
+        } }));
+    elements = std::vector<BasicElement<int>>();
+
+    benchOblivious("int", values, options, results);
+    benchDistributed("int", orderedKeys(values), options, results);
+}
+
+static void benchStrings(const BenchOptions& options, std::vector<BenchResult>& results) {
+    const std::vector<std::string> values = makeStrings(options.n, options.distribution, 2);
+    std::vector<std::string> copy;
+    results.push_back(measure("std::sort", "string", values.size(), options, Trial{
+        [&] { copy = values; },
+        [&] { std::sort(copy.begin(), copy.end()); },
+        [] { return uint64_t(0); },
+        [&] { return std::is_sorted(copy.begin(), copy.end()); } }));
+    copy = std::vector<std::string>();
+
+    // Enclave::bitonicSort orders Elements by their int key only; string values go through
+    // the same network on packed tags, compared by payload value.
+    ElementStore store = ElementStore::fromStrings(values);
+    std::vector<ElementTag> tags;
+    results.push_back(measure("bitonicSort", "string", values.size(), options, Trial{
+        [&] { tags = store.tags; },
+        [&] { store.sortByValue(tags, 0, tags.size(), true); },
+        [] { return uint64_t(0); },
+        [&] {
+            return std::is_sorted(tags.begin(), tags.end(),
+                [&store](const ElementTag& a, const ElementTag& b) { return store.before(a, b); });
+        } }));
+    store = ElementStore();
+    tags = std::vector<ElementTag>();
+
+    benchOblivious("string", values, options, results);
+    benchDistributed("string", values, options, results);
+}
+
+static double throughput(const BenchResult& r) {
+    return r.wall_ms > 0 ? r.n / (r.wall_ms * 1000.0) : 0;
+}
+
+static void printCsv(const std::vector<BenchResult>& results) {
+    std::cout << "algorithm,input,n,wall_ms,melem_per_s,peak_rss_kib,rss_before_kib,moved_bytes,sorted\n";
+    for (const auto& r : results)
+        std::cout << r.algorithm << "," << r.input << "," << r.n << "," << std::fixed << std::setprecision(3)
+                  << r.wall_ms << "," << throughput(r) << "," << r.peak_rss_kib << "," << r.rss_before_kib << ","
+                  << r.moved_bytes << "," << (r.sorted ? "yes" : "no") << "\n";
+}
+
+static void printJson(const std::vector<BenchResult>& results, const std::string& distribution,
+                      const BenchOptions& options) {
+    std::cout << "{\n  \"distribution\": \"" << distribution << "\",\n"
+              << "  \"bucket_size\": " << options.bucket_size << ",\n"
+              << "  \"num_enclaves\": " << options.num_enclaves << ",\n"
+              << "  \"num_threads\": " << options.num_threads << ",\n"
+              << "  \"repeats\": " << options.repeats << ",\n"
+              << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        std::cout << "    {\"algorithm\": \"" << r.algorithm << "\", \"input\": \"" << r.input
+                  << "\", \"n\": " << r.n << std::fixed << std::setprecision(3)
+                  << ", \"wall_ms\": " << r.wall_ms << ", \"melem_per_s\": " << throughput(r)
+                  << ", \"peak_rss_kib\": " << r.peak_rss_kib << ", \"rss_before_kib\": " << r.rss_before_kib
+                  << ", \"moved_bytes\": " << r.moved_bytes << ", \"sorted\": " << (r.sorted ? "true" : "false")
+                  << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    std::cout << "  ]\n}\n";
+}
+
+int main(int argc, char** argv) {
+    try {
+        BenchOptions options;
+        options.n = argc > 1 ? std::stoul(argv[1]) : size_t(1) << 20;
+        std::string input = argc > 2 ? argv[2] : "all";
+        std::string distribution = argc > 3 ? argv[3] : "uniform";
+        std::string format = argc > 4 ? argv[4] : "csv";
+        options.distribution = parseDistribution(distribution);
+        options.bucket_size = argc > 5 ? std::stoi(argv[5]) : 256;
+        options.num_enclaves = argc > 6 ? std::stoi(argv[6]) : 8;
+        options.num_threads = argc > 7 ? std::stoi(argv[7]) : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        options.repeats = argc > 8 ? std::max(1, std::stoi(argv[8])) : 1;
+        if (argc > 9)
+            options.seed = std::stoull(argv[9]);
+        if (input != "int" && input != "string" && input != "all")
+            throw std::invalid_argument("Unknown input type " + input);
+        if (format != "csv" && format != "json")
+            throw std::invalid_argument("Unknown output format " + format);
+
+        std::vector<BenchResult> results;
+        if (input != "string")
+            benchInts(options, results);
+        if (input != "int")
+            benchStrings(options, results);
+
+        if (format == "json") {
+            printJson(results, distribution, options);
+        }
+        else {
+            std::cout << "# distribution = " << distribution << ", bucket_size = " << options.bucket_size
+                      << ", enclaves = " << options.num_enclaves << ", threads = " << options.num_threads
+                      << ", repeats = " << options.repeats << "\n";
+            printCsv(results);
+        }
+    }
+    catch (const std::exception& ex) {
+        std::cerr << "Error: " << ex.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
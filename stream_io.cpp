@@ -0,0 +1,241 @@
+#include "stream_io.h"
+#include <queue>
+#include <deque>
+#include <algorithm>
+#include <stdexcept>
+#include <limits>
+#include <cstring>
+
+// ----- Sources and Sinks -----
+LineFileSource::LineFileSource(const std::string& path) : in(path) {
+    if (!in)
+        throw std::runtime_error("Cannot open input file " + path);
+}
+
+bool LineFileSource::next(std::string& value) {
+    return static_cast<bool>(std::getline(in, value));
+}
+
+LineFileSink::LineFileSink(const std::string& path) : buffer(1 << 20) {
+    out.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+    out.open(path, std::ios::binary);
+    if (!out)
+        throw std::runtime_error("Cannot open output file " + path);
+}
+
+void LineFileSink::write(std::string_view value) {
+    out.write(value.data(), value.size());
+    out.put('\n');
+    if (!out)
+        throw std::runtime_error("Cannot write output file.");
+}
+
+bool VectorSource::next(std::string& value) {
+    if (position == values.size())
+        return false;
+    value = values[position++];
+    return true;
+}
+
+// Associated data of a sealed spool record or run block: its file and offset.
+static void fileLocation(uint64_t file_id, uint64_t offset, uint8_t aad[16]) {
+    std::memcpy(aad, &file_id, 8);
+    std::memcpy(aad + 8, &offset, 8);
+}
+
+// ----- PayloadSpool Methods -----
+PayloadSpool::PayloadSpool(const std::string& directory, BucketCipher& cipher, uint64_t file_id)
+    : cipher(&cipher), file_id(file_id), bytes(directory), offsets(directory) {}
+
+uint32_t PayloadSpool::append(std::string_view value) {
+    if (count == std::numeric_limits<uint32_t>::max())
+        throw std::overflow_error("Too many payloads for 32-bit indices.");
+    uint64_t begin = bytes.size();
+    sealed.resize(sizeof(BucketSeal) + value.size());
+    uint8_t aad[16];
+    fileLocation(file_id, begin, aad);
+    BucketSeal seal;
+    cipher->seal(reinterpret_cast<const uint8_t*>(value.data()), sealed.data() + sizeof(BucketSeal),
+                 value.size(), aad, sizeof(aad), seal);
+    std::memcpy(sealed.data(), &seal, sizeof(seal));
+    bytes.append(sealed.data(), sealed.size());
+    offsets.append(&begin, sizeof(begin));
+    return static_cast<uint32_t>(count++);
+}
+
+void PayloadSpool::seal() {
+    uint64_t end = bytes.size();
+    offsets.append(&end, sizeof(end));
+    byte_map = MappedRegion(bytes, false);
+    offset_map = MappedRegion(offsets, false);
+}
+
+void PayloadSpool::read(uint32_t index, std::string& value) const {
+    const uint64_t* record = reinterpret_cast<const uint64_t*>(offset_map.data()) + index;
+    if (record[1] < record[0] + sizeof(BucketSeal) || record[1] > byte_map.size())
+        throw std::runtime_error("Payload spool is corrupt.");
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(byte_map.data()) + record[0];
+    BucketSeal seal;
+    std::memcpy(&seal, src, sizeof(seal));
+    value.resize(record[1] - record[0] - sizeof(BucketSeal));
+    uint8_t aad[16];
+    fileLocation(file_id, record[0], aad);
+    cipher->open(src + sizeof(BucketSeal), reinterpret_cast<uint8_t*>(&value[0]), value.size(),
+                 aad, sizeof(aad), seal);
+}
+
+// ----- SortedRuns Methods -----
+SortedRuns::SortedRuns(const std::string& directory, BucketCipher& cipher, uint64_t file_id, size_t block_bytes)
+    : cipher(&cipher), file_id(file_id), block_bytes(block_bytes), file(directory),
+      block(block_bytes), sealed(sizeof(BucketSeal) + block_bytes) {
+    if (block_bytes == 0)
+        throw std::invalid_argument("Run blocks must hold at least one byte.");
+}
+
+void SortedRuns::sealBlock() {
+    std::memset(block.data() + filled, 0, block_bytes - filled);
+    uint8_t aad[16];
+    fileLocation(file_id, file.size(), aad);
+    BucketSeal seal;
+    cipher->seal(block.data(), sealed.data() + sizeof(BucketSeal), block_bytes, aad, sizeof(aad), seal);
+    std::memcpy(sealed.data(), &seal, sizeof(seal));
+    file.append(sealed.data(), sealed.size());
+    runs.back().blocks++;
+    filled = 0;
+}
+
+void SortedRuns::appendBytes(const void* data, size_t len) {
+    const uint8_t* in = static_cast<const uint8_t*>(data);
+    while (len > 0) {
+        size_t chunk = std::min(len, block_bytes - filled);
+        std::memcpy(block.data() + filled, in, chunk);
+        filled += chunk;
+        in += chunk;
+        len -= chunk;
+        if (filled == block_bytes)
+            sealBlock();
+    }
+}
+
+// A record is a 32-bit length, then the value bytes.
+void SortedRuns::addRun(const std::vector<ElementTag>& tags, const PayloadArena& payloads) {
+    runs.push_back(Run{ file.size(), 0, 0 });
+    for (const auto& tag : tags) {
+        std::string_view value = payloads.view(tag.payload);
+        uint32_t len = static_cast<uint32_t>(value.size());
+        appendBytes(&len, sizeof(len));
+        appendBytes(value.data(), value.size());
+        runs.back().bytes += sizeof(len) + value.size();
+    }
+    if (filled > 0)
+        sealBlock();
+}
+
+namespace {
+
+// Values of one run opened so far and not yet written out.
+struct RunBuffer {
+    std::string partial;               // Bytes of a record cut by the end of a block.
+    std::deque<std::string> values;
+    std::string last;                  // Last complete value read.
+    bool any = false;                  // Whether last is set.
+    size_t remaining;                  // Plaintext bytes of the run not yet opened.
+    size_t buffered = 0;               // Bytes held in partial and values.
+
+    // Appends the valid bytes of one opened block and splits off the complete records.
+    void decode(const uint8_t* data, size_t len) {
+        partial.append(reinterpret_cast<const char*>(data), len);
+        remaining -= len;
+        size_t head = 0;
+        uint32_t value_len;
+        while (partial.size() - head >= sizeof(value_len)) {
+            std::memcpy(&value_len, partial.data() + head, sizeof(value_len));
+            if (partial.size() - head - sizeof(value_len) < value_len)
+                break;
+            values.emplace_back(partial, head + sizeof(value_len), value_len);
+            head += sizeof(value_len) + value_len;
+            buffered += value_len;
+        }
+        partial.erase(0, head);
+        if (!values.empty()) {
+            last = values.back();
+            any = true;
+        }
+        if (remaining == 0 && !partial.empty())
+            throw std::runtime_error("Sorted run is truncated.");
+    }
+};
+
+} // namespace
+
+void SortedRuns::merge(StringSink& sink, TrustedMemory* memory) {
+    file.flush();
+    size_t steps = 0;
+    std::vector<RunBuffer> buffers(runs.size());
+    for (size_t r = 0; r < runs.size(); r++) {
+        buffers[r].remaining = runs[r].bytes;
+        steps = std::max(steps, runs[r].blocks);
+    }
+    std::vector<uint8_t> plain(block_bytes);
+    TrustedMemory::Charge block_memory, value_memory;
+    if (memory)
+        block_memory = memory->charge(sealed.size() + plain.size());
+
+    auto later = [&](size_t a, size_t b) { return buffers[a].values.front() > buffers[b].values.front(); };
+    for (size_t s = 0; s < steps; s++) {
+        size_t held = 0;
+        for (size_t r = 0; r < runs.size(); r++) {
+            RunBuffer& buffer = buffers[r];
+            if (s < runs[r].blocks) {
+                size_t offset = runs[r].begin + s * sealed.size();
+                if (file.readAt(offset, sealed.data(), sealed.size()) != sealed.size())
+                    throw std::runtime_error("Sorted run is truncated.");
+                BucketSeal seal;
+                std::memcpy(&seal, sealed.data(), sizeof(seal));
+                uint8_t aad[16];
+                fileLocation(file_id, offset, aad);
+                cipher->open(sealed.data() + sizeof(BucketSeal), plain.data(), block_bytes, aad, sizeof(aad), seal);
+                buffer.decode(plain.data(), std::min(block_bytes, buffer.remaining));
+            }
+            held += buffer.buffered + buffer.partial.size();
+        }
+        if (memory) {
+            memory->touch(runs.size() * (sealed.size() + plain.size()));
+            value_memory = TrustedMemory::Charge();
+            value_memory = memory->charge(held);
+        }
+
+        // Every value still to be read from an unfinished run is at least its last value.
+        const std::string* bound = nullptr;
+        bool last_step = s + 1 == steps;
+        bool blocked = false;
+        for (size_t r = 0; r < runs.size() && !last_step; r++) {
+            if (s + 1 >= runs[r].blocks)
+                continue;
+            if (!buffers[r].any) {
+                blocked = true;
+                break;
+            }
+            if (!bound || buffers[r].last < *bound)
+                bound = &buffers[r].last;
+        }
+        if (blocked)
+            continue;
+        std::priority_queue<size_t, std::vector<size_t>, decltype(later)> heads(later);
+        for (size_t r = 0; r < runs.size(); r++)
+            if (!buffers[r].values.empty())
+                heads.push(r);
+        while (!heads.empty()) {
+            size_t r = heads.top();
+            RunBuffer& buffer = buffers[r];
+            if (bound && *bound < buffer.values.front())
+                break;
+            heads.pop();
+            sink.write(buffer.values.front());
+            buffer.buffered -= buffer.values.front().size();
+            buffer.values.pop_front();
+            if (!buffer.values.empty())
+                heads.push(r);
+        }
+    }
+}
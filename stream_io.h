@@ -0,0 +1,152 @@
+#ifndef STREAM_IO_H
+#define STREAM_IO_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <cstdint>
+#include <cstddef>
+#include "element_store.h"
+#include "mapped_storage.h"
+#include "bucket_cipher.h"
+#include "trusted_memory.h"
+
+// Input and output of the streaming oblivious sort (Enclave::oblivious_sort_stream).
+
+// Produces the values to sort, one at a time.
+class StringSource {
+public:
+    virtual ~StringSource() = default;
+    // Stores the next value in value and returns true, or returns false at the end.
+    virtual bool next(std::string& value) = 0;
+};
+
+// Receives the sorted values in order.
+class StringSink {
+public:
+    virtual ~StringSink() = default;
+    virtual void write(std::string_view value) = 0;
+};
+
+// One value per line of a text file.
+class LineFileSource : public StringSource {
+public:
+    explicit LineFileSource(const std::string& path);
+    bool next(std::string& value) override;
+
+private:
+    std::ifstream in;
+};
+
+class LineFileSink : public StringSink {
+public:
+    explicit LineFileSink(const std::string& path);
+    void write(std::string_view value) override;
+
+private:
+    std::vector<char> buffer;  // Declared first: the stream flushes into it on destruction.
+    std::ofstream out;
+};
+
+class VectorSource : public StringSource {
+public:
+    explicit VectorSource(const std::vector<std::string>& values) : values(values) {}
+    bool next(std::string& value) override;
+
+private:
+    const std::vector<std::string>& values;
+    size_t position = 0;
+};
+
+class VectorSink : public StringSink {
+public:
+    std::vector<std::string> values;
+    void write(std::string_view value) override { values.emplace_back(value); }
+};
+
+struct StreamingOptions {
+    // Directory for the payload spool and the sorted runs.
+    std::string scratch_directory = defaultScratchDirectory();
+    // Payload bytes sorted in memory at a time by the final sort; larger outputs are
+    // sorted in runs of about this size and merged.
+    size_t run_bytes = size_t(256) << 20;
+    // Plaintext bytes per sealed block of a sorted run; the merge reads one block of
+    // every run per step.
+    size_t block_bytes = size_t(64) << 10;
+};
+
+// Payloads of a streaming sort, spooled to a scratch file as they are read and then
+// mapped, so only the pages being touched need to be in memory. Every payload is sealed
+// on its own with the enclave's cipher, bound to (file_id, offset), and only opened into
+// enclave buffers; its length is visible, as with any variable-length record.
+class PayloadSpool {
+public:
+    PayloadSpool(const std::string& directory, BucketCipher& cipher, uint64_t file_id);
+
+    // Appends a payload and returns its index. Only valid before seal().
+    uint32_t append(std::string_view value);
+
+    // Ends the input and maps the spool for reading.
+    void seal();
+
+    // Decrypts payload index into value. Throws std::runtime_error if it does not verify.
+    void read(uint32_t index, std::string& value) const;
+
+    size_t size() const { return count; }
+
+private:
+    BucketCipher* cipher;
+    uint64_t file_id;
+    ScratchFile bytes;    // Per payload: its BucketSeal, then the ciphertext.
+    ScratchFile offsets;  // Start of every record, then the end of the file.
+    MappedRegion byte_map;
+    MappedRegion offset_map;
+    size_t count = 0;
+    std::vector<uint8_t> sealed;
+};
+
+// External sort of the extracted tags: runs of roughly options.run_bytes payload bytes
+// are sorted in memory with a final-sort engine and written to a scratch file, then
+// merged into the sink. A run is a stream of length-prefixed values cut into sealed
+// blocks of block_bytes (the last one zero-padded), each bound to (file_id, offset).
+class SortedRuns {
+public:
+    SortedRuns(const std::string& directory, BucketCipher& cipher, uint64_t file_id, size_t block_bytes);
+
+    // Appends one sorted run of values.
+    void addRun(const std::vector<ElementTag>& tags, const PayloadArena& payloads);
+
+    size_t runCount() const { return runs.size(); }
+
+    // Writes every value of every run to sink in ascending order. Step s reads and opens
+    // block s of every run that has one, so the reads depend only on the run lengths.
+    // After each step, the buffered values no larger than the last value read from every
+    // unfinished run are written out. Runs are groups of whole final buckets, which are
+    // random subsets of the input, so each run advances through the key range at about
+    // the same rate and the buffers stay around a few blocks per run. The block buffers
+    // and buffered values are charged to memory, if given.
+    void merge(StringSink& sink, TrustedMemory* memory = nullptr);
+
+private:
+    struct Run {
+        size_t begin;   // Offset of the first sealed block.
+        size_t blocks;
+        size_t bytes;   // Plaintext bytes, without the padding of the last block.
+    };
+
+    void appendBytes(const void* data, size_t len);
+    void sealBlock();
+
+    BucketCipher* cipher;
+    uint64_t file_id;
+    size_t block_bytes;
+    ScratchFile file;
+    std::vector<Run> runs;
+    std::vector<uint8_t> block;  // Plaintext of the block being filled.
+    size_t filled = 0;
+    std::vector<uint8_t> sealed;
+};
+
+#endif // STREAM_IO_H
@@ -0,0 +1,114 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(int num_threads, Schedule schedule) : mode(schedule) {
+    int total = std::max(1, num_threads);
+    for (int i = 0; i < total; i++)
+        queues.push_back(std::make_unique<WorkQueue>());
+    for (int i = 1; i < total; i++)
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    start_cv.notify_all();
+    for (auto& t : workers)
+        t.join();
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& fn) {
+    if (count == 0)
+        return;
+    if (workers.empty()) {
+        for (size_t i = 0; i < count; i++)
+            fn(i);
+        return;
+    }
+
+    int participants = size();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &fn;
+        error = nullptr;
+        // Static split of the range; with work stealing it is only the starting point.
+        for (int p = 0; p < participants; p++) {
+            size_t begin = count * p / participants;
+            size_t end = count * (p + 1) / participants;
+            std::lock_guard<std::mutex> qlock(queues[p]->mutex);
+            queues[p]->indices.clear();
+            for (size_t i = begin; i < end; i++)
+                queues[p]->indices.push_back(i);
+        }
+        pending = participants - 1;
+        generation++;
+    }
+    start_cv.notify_all();
+
+    runParticipant(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cv.wait(lock, [this] { return pending == 0; });
+    job = nullptr;
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void ThreadPool::workerLoop(int id) {
+    unsigned long seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            start_cv.wait(lock, [this, seen] { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+        }
+        runParticipant(id);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending--;
+        }
+        done_cv.notify_one();
+    }
+}
+
+void ThreadPool::runParticipant(int id) {
+    size_t index;
+    while (popOwn(id, index) || (mode == Schedule::WorkStealing && steal(id, index))) {
+        try {
+            (*job)(index);
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error)
+                error = std::current_exception();
+        }
+    }
+}
+
+bool ThreadPool::popOwn(int id, size_t& index) {
+    WorkQueue& q = *queues[id];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (q.indices.empty())
+        return false;
+    index = q.indices.front();
+    q.indices.pop_front();
+    return true;
+}
+
+bool ThreadPool::steal(int id, size_t& index) {
+    int n = static_cast<int>(queues.size());
+    for (int k = 1; k < n; k++) {
+        WorkQueue& q = *queues[(id + k) % n];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (!q.indices.empty()) {
+            index = q.indices.back();
+            q.indices.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
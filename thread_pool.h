@@ -0,0 +1,65 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <memory>
+#include <cstddef>
+
+// Fixed-size pool that runs index-parallel loops. parallelFor blocks until every index
+// has been processed, so consecutive calls are separated by a barrier. The calling
+// thread takes part in the work, so a pool of size 1 runs everything inline.
+class ThreadPool {
+public:
+    enum class Schedule {
+        Static,       // Each thread processes one contiguous chunk of the index range.
+        WorkStealing  // Threads start on their chunk and steal from others when idle.
+    };
+
+    ThreadPool(int num_threads, Schedule schedule = Schedule::Static);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return static_cast<int>(workers.size()) + 1; }
+    Schedule schedule() const { return mode; }
+
+    // Runs fn(i) for every i in [0, count). If any call throws, the first exception is
+    // rethrown here after all threads have stopped.
+    void parallelFor(size_t count, const std::function<void(size_t)>& fn);
+
+private:
+    // Per-participant queue of indices; owners pop from the front, thieves from the back.
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<size_t> indices;
+    };
+
+    void workerLoop(int id);
+    void runParticipant(int id);
+    bool popOwn(int id, size_t& index);
+    bool steal(int id, size_t& index);
+
+    Schedule mode;
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+
+    std::mutex mutex;
+    std::condition_variable start_cv;
+    std::condition_variable done_cv;
+    unsigned long generation = 0;
+    int pending = 0;
+    bool stopping = false;
+
+    // Current job.
+    const std::function<void(size_t)>* job = nullptr;
+    std::exception_ptr error;
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,100 @@
+// topk_bench.cpp (Benchmark: oblivious top-k selection vs. a full bitonic sort)
+// Usage: topk_bench [n = 1048576] [max_k = 65536] [trials = 3]
+// For k = 1, 4, 16, ... max_k, moves the k smallest of n random keys to the front with
+// Enclave::bitonicTopK and compares the best of `trials` runs with sorting the whole array
+// with Enclave::bitonicSort. The last row finds the median with bitonicSelect. Every
+// result is checked against std::nth_element.
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include "oblivious_sort.h"
+
+using IntElement = BasicElement<int>;
+
+template <class Fn>
+static double bestMs(int trials, const std::vector<IntElement>& input, Fn&& fn) {
+    double best = 0;
+    for (int t = 0; t < trials; t++) {
+        std::vector<IntElement> a = input;
+        auto start = std::chrono::steady_clock::now();
+        fn(a);
+        auto stop = std::chrono::steady_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(stop - start).count();
+        best = t == 0 ? ms : std::min(best, ms);
+    }
+    return best;
+}
+
+// The first k keys of a must be the k smallest of input, in order, and a must still hold
+// every element of input (values are the input positions).
+static bool smallestFirst(const std::vector<IntElement>& input, const std::vector<IntElement>& a, int k) {
+    std::vector<bool> seen(input.size(), false);
+    for (const IntElement& e : a) {
+        if (seen[e.value] || input[e.value].key != e.key)
+            return false;
+        seen[e.value] = true;
+    }
+    std::vector<int> keys(input.size());
+    for (size_t i = 0; i < input.size(); i++)
+        keys[i] = input[i].key;
+    std::partial_sort(keys.begin(), keys.begin() + k, keys.end());
+    for (int i = 0; i < k; i++)
+        if (a[i].key != keys[i])
+            return false;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int n = argc > 1 ? std::stoi(argv[1]) : 1 << 20;
+    int max_k = argc > 2 ? std::stoi(argv[2]) : 1 << 16;
+    int trials = argc > 3 ? std::stoi(argv[3]) : 3;
+
+    std::mt19937 gen(11);
+    std::vector<IntElement> input(n);
+    for (int i = 0; i < n; i++)
+        input[i] = IntElement{ i, static_cast<int>(gen()), false };
+
+    FlatUntrustedMemory untrusted;
+    Enclave enclave(&untrusted);
+    try {
+        double sort_ms = bestMs(trials, input, [&](std::vector<IntElement>& a) { enclave.bitonicSort(a, 0, n, true); });
+        std::cout << "simd = " << cmpex::simdLevelName(cmpex::activeSimdLevel()) << ", n = " << n
+                  << ", full bitonicSort " << std::fixed << std::setprecision(3) << sort_ms << " ms\n";
+        std::cout << "k,select_ms,sort_ms,speedup,correct\n";
+        bool all_correct = true;
+        for (int k = 1; k <= std::min(max_k, n); k *= 4) {
+            std::vector<IntElement> out;
+            double select_ms = bestMs(trials, input, [&](std::vector<IntElement>& a) {
+                enclave.bitonicTopK(a, 0, n, k, true);
+                out.swap(a);
+            });
+            bool correct = smallestFirst(input, out, k);
+            all_correct = all_correct && correct;
+            std::cout << k << "," << select_ms << "," << sort_ms << "," << std::setprecision(2)
+                      << sort_ms / select_ms << std::setprecision(3) << "," << (correct ? "yes" : "no") << "\n";
+        }
+
+        IntElement median{};
+        double median_ms = bestMs(trials, input, [&](std::vector<IntElement>& a) {
+            median = enclave.bitonicSelect(a, 0, n, n / 2);
+        });
+        std::vector<int> keys(n);
+        for (int i = 0; i < n; i++)
+            keys[i] = input[i].key;
+        std::nth_element(keys.begin(), keys.begin() + n / 2, keys.end());
+        bool median_correct = median.key == keys[n / 2];
+        all_correct = all_correct && median_correct;
+        std::cout << "median," << median_ms << "," << sort_ms << "," << std::setprecision(2) << sort_ms / median_ms
+                  << "," << (median_correct ? "yes" : "no") << "\n";
+        std::cout << "All selections correct? " << (all_correct ? "Yes" : "No") << "\n";
+        return all_correct ? 0 : 1;
+    }
+    catch (const std::exception& ex) {
+        std::cerr << "Error: " << ex.what() << "\n";
+        return 1;
+    }
+}
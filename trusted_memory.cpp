@@ -0,0 +1,79 @@
+#include "trusted_memory.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+TrustedMemory::Charge& TrustedMemory::Charge::operator=(Charge&& other) noexcept {
+    if (this != &other) {
+        release();
+        memory = other.memory;
+        bytes = other.bytes;
+        other.memory = nullptr;
+    }
+    return *this;
+}
+
+void TrustedMemory::Charge::release() {
+    if (memory)
+        memory->release(bytes);
+    memory = nullptr;
+}
+
+TrustedMemory::Charge TrustedMemory::charge(size_t bytes) {
+    size_t now = current.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    if (epc.strict && now > epc.budget_bytes) {
+        current.fetch_sub(bytes, std::memory_order_relaxed);
+        throw std::length_error("Trusted working set of " + std::to_string(now) +
+                                " bytes exceeds the EPC budget of " + std::to_string(epc.budget_bytes) + ".");
+    }
+    size_t seen = phase_peak.load(std::memory_order_relaxed);
+    while (seen < now && !phase_peak.compare_exchange_weak(seen, now, std::memory_order_relaxed)) {
+    }
+    return Charge(this, bytes);
+}
+
+TrustedMemory::Phase::Phase(TrustedMemory* memory, const char* name) : memory(memory), name(name) {
+    memory->phase_peak.store(memory->resident(), std::memory_order_relaxed);
+    memory->touched.store(0, std::memory_order_relaxed);
+}
+
+TrustedMemory::Phase::~Phase() {
+    const EpcConfig& epc = memory->epc;
+    size_t peak = memory->phase_peak.load(std::memory_order_relaxed);
+    uint64_t bytes = memory->touched.load(std::memory_order_relaxed);
+    uint64_t faults = 0;
+    if (peak > epc.budget_bytes) {
+        double missing = 1.0 - static_cast<double>(epc.budget_bytes) / peak;
+        faults = static_cast<uint64_t>(bytes * missing / epc.page_bytes + 0.5);
+    }
+    std::lock_guard<std::mutex> lock(memory->phase_mutex);
+    memory->peak_total = std::max(memory->peak_total, peak);
+    memory->usage.push_back(PhaseUsage{ name, peak, bytes, faults, faults });
+}
+
+uint64_t TrustedMemory::pageIns() const {
+    uint64_t total = 0;
+    for (const auto& p : usage)
+        total += p.page_ins;
+    return total;
+}
+
+uint64_t TrustedMemory::pageOuts() const {
+    uint64_t total = 0;
+    for (const auto& p : usage)
+        total += p.page_outs;
+    return total;
+}
+
+double TrustedMemory::pagingMs() const {
+    double total = 0;
+    for (const auto& p : usage)
+        total += p.pagingMs(epc);
+    return total;
+}
+
+void TrustedMemory::clear() {
+    std::lock_guard<std::mutex> lock(phase_mutex);
+    usage.clear();
+    peak_total = 0;
+}
@@ -0,0 +1,111 @@
+#ifndef TRUSTED_MEMORY_H
+#define TRUSTED_MEMORY_H
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <cstddef>
+#include <cstdint>
+
+// Simulated enclave page cache (EPC). An SGX enclave has a fixed amount of protected
+// memory; once its working set grows past it, pages are evicted (encrypted out to normal
+// memory) and faulted back in, each at a cost of tens of microseconds.
+struct EpcConfig {
+    // Usable EPC. About 90 MiB of the 128 MiB EPC of SGX1 parts is left for enclave pages.
+    size_t budget_bytes = size_t(90) << 20;
+    size_t page_bytes = 4096;
+    // Cost of one page fault that loads a page back (ELDU) and of one eviction (EWB),
+    // about 40k cycles each.
+    double page_in_ns = 12000;
+    double page_out_ns = 12000;
+    // Throw std::length_error as soon as the working set would exceed the budget, instead
+    // of counting the paging it causes.
+    bool strict = false;
+};
+
+// Trusted working set of a sort and the paging it would cost. Code charges the buffers it
+// holds in enclave memory for as long as it holds them, and reports the bytes it touches;
+// both are thread-safe. For every phase, the peak working set W and the bytes touched T
+// give the simulated paging: with W above the budget E, a touched page is resident with
+// probability E / W, so T * (1 - E / W) bytes are faulted in, each fault evicting a page.
+class TrustedMemory {
+public:
+    explicit TrustedMemory(const EpcConfig& config = EpcConfig()) : epc(config) {}
+
+    // Bytes charged until the Charge is destroyed.
+    class Charge {
+    public:
+        Charge() = default;
+        Charge(TrustedMemory* memory, size_t bytes) : memory(memory), bytes(bytes) {}
+        Charge(Charge&& other) noexcept : memory(other.memory), bytes(other.bytes) { other.memory = nullptr; }
+        Charge& operator=(Charge&& other) noexcept;
+        ~Charge() { release(); }
+
+        Charge(const Charge&) = delete;
+        Charge& operator=(const Charge&) = delete;
+
+        void release();
+
+    private:
+        TrustedMemory* memory = nullptr;
+        size_t bytes = 0;
+    };
+
+    // Adds bytes to the working set. In strict mode, throws std::length_error if that
+    // would exceed the budget.
+    Charge charge(size_t bytes);
+
+    // Bytes of trusted memory read or written.
+    void touch(uint64_t bytes) { touched.fetch_add(bytes, std::memory_order_relaxed); }
+
+    struct PhaseUsage {
+        const char* name;  // A string literal.
+        size_t peak_bytes;
+        uint64_t touched_bytes;
+        uint64_t page_ins;
+        uint64_t page_outs;
+
+        double pagingMs(const EpcConfig& epc) const {
+            return (page_ins * epc.page_in_ns + page_outs * epc.page_out_ns) / 1e6;
+        }
+    };
+
+    // Accounts the enclosing scope as one phase. Phases do not nest.
+    class Phase {
+    public:
+        Phase(TrustedMemory* memory, const char* name);
+        ~Phase();
+
+        Phase(const Phase&) = delete;
+        Phase& operator=(const Phase&) = delete;
+
+    private:
+        TrustedMemory* memory;
+        const char* name;
+    };
+
+    // Every phase so far, in the order they ended.
+    const std::vector<PhaseUsage>& phases() const { return usage; }
+
+    size_t resident() const { return current.load(std::memory_order_relaxed); }
+    size_t peakBytes() const { return peak_total; }
+    uint64_t pageIns() const;
+    uint64_t pageOuts() const;
+    double pagingMs() const;
+
+    const EpcConfig& config() const { return epc; }
+    void clear();
+
+private:
+    void release(size_t bytes) { current.fetch_sub(bytes, std::memory_order_relaxed); }
+
+    EpcConfig epc;
+    std::atomic<size_t> current{ 0 };
+    std::atomic<size_t> phase_peak{ 0 };
+    std::atomic<uint64_t> touched{ 0 };
+    size_t peak_total = 0;
+    std::mutex phase_mutex;
+    std::vector<PhaseUsage> usage;
+};
+
+#endif // TRUSTED_MEMORY_H
@@ -0,0 +1,74 @@
+#include "untrusted_storage.h"
+#include <algorithm>
+#include <stdexcept>
+
+// ----- FlatUntrustedMemory Methods -----
+FlatUntrustedMemory::FlatUntrustedMemory(LevelRetention retention) : mode(retention) {
+    resident_level[0] = -1;
+    resident_level[1] = -1;
+}
+
+size_t FlatUntrustedMemory::footprintBytes(int B, int L, int Z, LevelRetention retention) {
+    size_t levels = retention == LevelRetention::PingPong ? std::min(L + 1, 2) : L + 1;
+    return levels * static_cast<size_t>(B) * (Z * sizeof(ElementTag) + sizeof(BucketSeal));
+}
+
+void FlatUntrustedMemory::allocate(int B, int L, int Z) {
+    num_buckets = B;
+    num_levels = L + 1;
+    bucket_size = Z;
+    size_t buffers = mode == LevelRetention::PingPong ? std::min<size_t>(num_levels, 2) : num_levels;
+    arena.assign(buffers * num_buckets * bucket_size, ElementTag{ 0, 0, 1 });
+    seals.assign(buffers * num_buckets, BucketSeal{});
+    peak_bytes = std::max(peak_bytes, arena.size() * sizeof(ElementTag) + seals.size() * sizeof(BucketSeal));
+    resident_level[0] = -1;
+    resident_level[1] = -1;
+}
+
+void FlatUntrustedMemory::checkBounds(int level, int bucket_index) const {
+    if (level < 0 || static_cast<size_t>(level) >= num_levels ||
+        bucket_index < 0 || static_cast<size_t>(bucket_index) >= num_buckets)
+        throw std::out_of_range("Bucket outside the allocated untrusted arena.");
+}
+
+ConstBucketView FlatUntrustedMemory::read_view(int level, int bucket_index) {
+    checkBounds(level, bucket_index);
+    if (mode == LevelRetention::PingPong &&
+        resident_level[buffer(level)].load(std::memory_order_relaxed) != level)
+        throw std::logic_error("Level is no longer resident in the ping-pong buffers.");
+    traceAccess(AccessOp::Read, level, bucket_index, bucket_size);
+    return ConstBucketView{ arena.data() + offset(level, bucket_index), bucket_size };
+}
+
+BucketView FlatUntrustedMemory::write_view(int level, int bucket_index) {
+    checkBounds(level, bucket_index);
+    if (mode == LevelRetention::PingPong)
+        resident_level[buffer(level)].store(level, std::memory_order_relaxed);
+    traceAccess(AccessOp::Write, level, bucket_index, bucket_size);
+    return BucketView{ arena.data() + offset(level, bucket_index), bucket_size };
+}
+
+BucketSeal* FlatUntrustedMemory::seal_slot(int level, int bucket_index) {
+    checkBounds(level, bucket_index);
+    return &seals[buffer(level) * num_buckets + bucket_index];
+}
+
+// ----- CountingUntrustedStorage Methods -----
+ConstBucketView CountingUntrustedStorage::read_view(int level, int bucket_index) {
+    ConstBucketView view = inner->read_view(level, bucket_index);
+    traceAccess(AccessOp::Read, level, bucket_index, view.size);
+    bytes_read.fetch_add(view.size * sizeof(ElementTag) + sizeof(BucketSeal), std::memory_order_relaxed);
+    return view;
+}
+
+BucketView CountingUntrustedStorage::write_view(int level, int bucket_index) {
+    BucketView view = inner->write_view(level, bucket_index);
+    traceAccess(AccessOp::Write, level, bucket_index, view.size);
+    bytes_written.fetch_add(view.size * sizeof(ElementTag) + sizeof(BucketSeal), std::memory_order_relaxed);
+    return view;
+}
+
+void CountingUntrustedStorage::resetCounters() {
+    bytes_read.store(0, std::memory_order_relaxed);
+    bytes_written.store(0, std::memory_order_relaxed);
+}
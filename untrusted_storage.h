@@ -0,0 +1,142 @@
+#ifndef UNTRUSTED_STORAGE_H
+#define UNTRUSTED_STORAGE_H
+
+#include <vector>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "element_store.h"
+#include "bucket_cipher.h"
+#include "instrumentation.h"
+
+// Non-owning view over the slots of one bucket.
+template <class T>
+struct BasicBucketView {
+    T* data = nullptr;
+    size_t size = 0;
+
+    T* begin() const { return data; }
+    T* end() const { return data + size; }
+    T& operator[](size_t i) const { return data[i]; }
+    bool empty() const { return size == 0; }
+};
+
+using BucketView = BasicBucketView<ElementTag>;
+using ConstBucketView = BasicBucketView<const ElementTag>;
+
+// Interface for untrusted bucket storage. Buckets are addressed by (level, bucket_index)
+// and accessed in place through views, so reading or writing a bucket never copies it.
+// Views stay valid until the next allocate() call.
+class UntrustedStorage {
+public:
+    virtual ~UntrustedStorage() = default;
+
+    // Prepares storage for B buckets of Z slots on each of the levels 0..L.
+    virtual void allocate(int B, int L, int Z) = 0;
+
+    // Read-only view of a stored (encrypted) bucket. Empty if the bucket was never written.
+    virtual ConstBucketView read_view(int level, int bucket_index) = 0;
+
+    // Writable view of a bucket's Z slots; the caller fills it in place.
+    virtual BucketView write_view(int level, int bucket_index) = 0;
+
+    // Nonce and authentication tag stored alongside the bucket.
+    virtual BucketSeal* seal_slot(int level, int bucket_index) = 0;
+
+    // Hint that the bucket will be read soon. Backends that page from disk start the I/O.
+    virtual void prefetch(int /*level*/, int /*bucket_index*/) {}
+
+    // Every bucket of the level has been read and will not be read again.
+    virtual void release_level(int /*level*/) {}
+
+    // Optional log of the accesses an observer of this storage sees: backends record every
+    // read_view and write_view into it. Null (the default) records nothing.
+    void setAccessTrace(AccessTrace* trace) { access_trace = trace; }
+    AccessTrace* accessTrace() const { return access_trace; }
+
+protected:
+    void traceAccess(AccessOp op, int level, int bucket_index, size_t slots) {
+        if constexpr (kInstrumentationEnabled)
+            if (access_trace)
+                access_trace->record(op, level, bucket_index, slots * sizeof(ElementTag));
+    }
+
+private:
+    AccessTrace* access_trace = nullptr;
+};
+
+// How many butterfly levels a backend keeps resident.
+enum class LevelRetention {
+    PingPong,    // Only the level being read and the level being written: 2 * B * Z slots.
+    FullHistory  // Every level 0..L, for debugging: (L + 1) * B * Z slots.
+};
+
+// Flat backend: one contiguous arena allocated once per sort. A bucket is located by
+// index arithmetic; there is no lookup and no locking, since concurrent writers always
+// touch disjoint buckets. In PingPong mode level l lives in buffer l % 2, so writing
+// level l + 2 reuses the memory of level l.
+class FlatUntrustedMemory : public UntrustedStorage {
+public:
+    explicit FlatUntrustedMemory(LevelRetention retention = LevelRetention::PingPong);
+
+    void allocate(int B, int L, int Z) override;
+    ConstBucketView read_view(int level, int bucket_index) override;
+    BucketView write_view(int level, int bucket_index) override;
+    BucketSeal* seal_slot(int level, int bucket_index) override;
+
+    LevelRetention retention() const { return mode; }
+    size_t slotCount() const { return arena.size(); }
+
+    // Largest arena held so far, in bytes.
+    size_t peakBytes() const { return peak_bytes; }
+
+    // Arena size (slots plus seals) for B buckets of Z slots over L butterfly levels.
+    static size_t footprintBytes(int B, int L, int Z, LevelRetention retention);
+
+private:
+    size_t buffer(int level) const {
+        return mode == LevelRetention::PingPong ? static_cast<size_t>(level) % 2 : static_cast<size_t>(level);
+    }
+    size_t offset(int level, int bucket_index) const {
+        return (buffer(level) * num_buckets + bucket_index) * bucket_size;
+    }
+    void checkBounds(int level, int bucket_index) const;
+
+    LevelRetention mode;
+    std::vector<ElementTag> arena;
+    std::vector<BucketSeal> seals;
+    size_t num_buckets = 0;
+    size_t num_levels = 0;
+    size_t bucket_size = 0;
+    size_t peak_bytes = 0;
+
+    // PingPong only: the level currently held by each of the two buffers, so a read of a
+    // level that has already been overwritten fails instead of returning stale data.
+    std::atomic<int> resident_level[2];
+};
+
+// Decorator that counts the bytes moving between the enclave and another backend. A
+// bucket view counts as Z slots plus its seal, read or written in full; this is what the
+// enclave transfers, independent of how the backend stores it.
+class CountingUntrustedStorage : public UntrustedStorage {
+public:
+    explicit CountingUntrustedStorage(UntrustedStorage* inner) : inner(inner) {}
+
+    void allocate(int B, int L, int Z) override { inner->allocate(B, L, Z); }
+    ConstBucketView read_view(int level, int bucket_index) override;
+    BucketView write_view(int level, int bucket_index) override;
+    BucketSeal* seal_slot(int level, int bucket_index) override { return inner->seal_slot(level, bucket_index); }
+    void prefetch(int level, int bucket_index) override { inner->prefetch(level, bucket_index); }
+    void release_level(int level) override { inner->release_level(level); }
+
+    uint64_t bytesRead() const { return bytes_read.load(std::memory_order_relaxed); }
+    uint64_t bytesWritten() const { return bytes_written.load(std::memory_order_relaxed); }
+    void resetCounters();
+
+private:
+    UntrustedStorage* inner;
+    std::atomic<uint64_t> bytes_read{ 0 };
+    std::atomic<uint64_t> bytes_written{ 0 };
+};
+
+#endif // UNTRUSTED_STORAGE_H
@@ -0,0 +1,97 @@
+#ifndef VALUE_TRAITS_H
+#define VALUE_TRAITS_H
+
+#include <array>
+#include <string_view>
+#include <stdexcept>
+#include <type_traits>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+// Fixed-size value types for the typed oblivious sort (Enclave::oblivious_sort<Value>).
+// Unlike strings these are stored and compared in place, with no payload arena.
+
+// Fixed-length byte string, ordered lexicographically by unsigned byte. Shorter inputs
+// are padded with zero bytes.
+template <size_t N>
+struct FixedBytes {
+    std::array<unsigned char, N> bytes{};
+
+    static FixedBytes from(std::string_view s) {
+        if (s.size() > N)
+            throw std::length_error("String longer than the fixed byte width.");
+        FixedBytes out;
+        std::memcpy(out.bytes.data(), s.data(), s.size());
+        return out;
+    }
+
+    // The bytes without the zero padding.
+    std::string_view view() const {
+        size_t len = N;
+        while (len > 0 && bytes[len - 1] == 0)
+            len--;
+        return std::string_view(reinterpret_cast<const char*>(bytes.data()), len);
+    }
+
+    bool operator<(const FixedBytes& other) const { return bytes < other.bytes; }
+    bool operator==(const FixedBytes& other) const { return bytes == other.bytes; }
+};
+
+// Sort key with the id of the record it belongs to; ordered by key, then id. Sorting these
+// yields a permutation of the records without moving the records themselves.
+template <class Key>
+struct KeyRecord {
+    Key key;
+    uint64_t record_id;
+
+    bool operator<(const KeyRecord& other) const {
+        return key < other.key || (!(other.key < key) && record_id < other.record_id);
+    }
+    bool operator==(const KeyRecord& other) const { return key == other.key && record_id == other.record_id; }
+};
+
+// ValueTraits<T> describes T as radix_width bytes, most significant first, whose unsigned
+// lexicographic order is the order of T (used by FinalSortEngine::Radix). Only the types
+// below are supported.
+template <class T, class = void>
+struct ValueTraits;
+
+template <class T>
+struct ValueTraits<T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>> {
+    static constexpr size_t radix_width = sizeof(T);
+
+    // Flips the sign bit of signed types so that unsigned order equals signed order.
+    static uint64_t orderedBits(T value) {
+        using U = std::make_unsigned_t<T>;
+        U bits = static_cast<U>(value);
+        if constexpr (std::is_signed_v<T>)
+            bits ^= U(1) << (8 * sizeof(T) - 1);
+        return bits;
+    }
+
+    static unsigned digit(const T& value, size_t pos) {
+        return static_cast<unsigned>(orderedBits(value) >> (8 * (radix_width - 1 - pos))) & 0xFFu;
+    }
+};
+
+template <size_t N>
+struct ValueTraits<FixedBytes<N>> {
+    static constexpr size_t radix_width = N;
+
+    static unsigned digit(const FixedBytes<N>& value, size_t pos) { return value.bytes[pos]; }
+};
+
+template <class Key>
+struct ValueTraits<KeyRecord<Key>> {
+    static constexpr size_t key_width = ValueTraits<Key>::radix_width;
+    static constexpr size_t radix_width = key_width + sizeof(uint64_t);
+
+    static unsigned digit(const KeyRecord<Key>& value, size_t pos) {
+        if (pos < key_width)
+            return ValueTraits<Key>::digit(value.key, pos);
+        return static_cast<unsigned>(value.record_id >> (8 * (radix_width - 1 - pos))) & 0xFFu;
+    }
+};
+
+#endif // VALUE_TRAITS_H